@@ -20,6 +20,7 @@
 
 namespace EmbDebug {
 
+class ITargetVectored;
 class TraceFlags;
 
 //! \brief Generic interface for target for the GDB server
@@ -30,7 +31,12 @@ class ITarget {
 public:
   //! The version number of the ITarget interface, used to verify that targets
   //! and the library are kept in sync.
-  static const uint64_t CURRENT_API_VERSION = 0x1ULL;
+  static const uint64_t CURRENT_API_VERSION = 0x4ULL;
+
+  //! The oldest version of the interface a target may be built for. Version
+  //! 0x4 added getVectored(), changing the layout of this class, so targets
+  //! built for earlier versions must be rebuilt.
+  static const uint64_t MIN_API_VERSION = 0x4ULL;
 
   //! The type of action which will be performed when a core is resumed.
   enum class ResumeType : int {
@@ -301,6 +307,51 @@ public:
   //! \return C string containing XML file, nullptr otherwise.
   virtual const char *getTargetXML(ByteView name EMBDEBUG_ATTR_UNUSED) = 0;
 
+  //! \brief Get a file descriptor which signals that a core has stopped
+  //!
+  //! Targets which run their cores asynchronously may provide a file
+  //! descriptor (for example an eventfd, or the read end of a pipe) which
+  //! becomes readable when a resumed core stops. The server will then sleep
+  //! until either the target or the client needs attention, rather than
+  //! calling wait() repeatedly. The target is responsible for draining the
+  //! file descriptor, typically in wait().
+  //!
+  //! This is optional. Targets which do not provide a file descriptor have
+  //! wait() called repeatedly while their cores are running.
+  //!
+  //! \return The file descriptor, or -1 if the target does not provide one.
+  virtual int getWakeupFd(void) { return -1; }
+
+  //! \brief Say whether a range of memory may be cached by the server
+  //!
+  //! While the cores are halted, the server may keep memory it has read, so
+  //! that reading it again does not need another call to read(). Targets
+  //! should report any memory whose contents change without a write from
+  //! the server, or whose reads have side effects, such as memory mapped
+  //! I/O, as not cacheable.
+  //!
+  //! This is optional. By default all memory may be cached.
+  //!
+  //! \param[in] addr  The start of the range.
+  //! \param[in] size  The number of bytes in the range.
+  //! \return True if every byte of the range may be cached.
+  virtual bool isCacheable(const uint_addr_t addr EMBDEBUG_ATTR_UNUSED,
+                           const std::size_t size EMBDEBUG_ATTR_UNUSED) {
+    return true;
+  }
+
+  //! \brief Get the target's vectored memory access interface
+  //!
+  //! Targets which can read several ranges of memory in one call implement
+  //! ITargetVectored as well, and return it here, typically as \c this. The
+  //! server asks for it explicitly, rather than casting, so that it can be
+  //! found whatever the target was built and loaded with.
+  //!
+  //! This is optional. By default the target has no vectored interface.
+  //!
+  //! \return The interface, or nullptr if the target does not provide one.
+  virtual ITargetVectored *getVectored(void) { return nullptr; }
+
 private:
   // Don't allow the default constructors
 
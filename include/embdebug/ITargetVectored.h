@@ -0,0 +1,56 @@
+// Vectored memory access extension to the target interface: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2008-2019 Embecosm Limited
+// SPDX-License-Identifier: MIT
+// ----------------------------------------------------------------------------
+
+#ifndef EMBDEBUG_ITARGET_VECTORED_H
+#define EMBDEBUG_ITARGET_VECTORED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Types.h"
+
+namespace EmbDebug {
+
+//! \brief Optional interface for targets which can access several ranges of
+//! memory in one call
+//!
+//! Targets reached through a debug probe pay a turnaround for every access,
+//! and may be able to pipeline a batch of accesses instead. Such a target
+//! derives from this class as well as from ITarget, and returns it from
+//! ITarget::getVectored(). The server uses it where it has several ranges
+//! of memory to read at once. Targets without it have ITarget::read()
+//! called for each range. Writes always go through ITarget::write(), since
+//! the server has no batches of writes to make.
+//!
+//! This was added in version 0x4 of the interface.
+class ITargetVectored {
+public:
+  //! One range of memory to read
+  struct ReadAccess {
+    uint_addr_t addr;  //!< Where to read
+    uint8_t *buffer;   //!< Where to put the bytes read
+    std::size_t size;  //!< The number of bytes to read
+    std::size_t count; //!< Set to the number of bytes read
+  };
+
+  virtual ~ITargetVectored(){};
+
+  //! \brief Read several ranges of memory from the current CPU
+  //!
+  //! Each range is handled as by ITarget::read(), and its count set to the
+  //! number of bytes read. The ranges may be read in any order.
+  //!
+  //! \param[in,out] accesses The ranges to read.
+  //! \return True if every range was read in full.
+  virtual bool readv(std::vector<ReadAccess> &accesses) = 0;
+};
+
+} // namespace EmbDebug
+
+#endif
@@ -39,7 +39,9 @@ using namespace EmbDebug;
 //! for use with GDB 6.8 or later. Sequence numbers were removed from the RSP
 //! standard at GDB 5.0.
 
-//! @param[in] pkt  The packet for storing the result.
+//! Where the whole of a packet is already in the receive buffer, the packet
+//! returned refers to it there rather than to a copy. It is then only valid
+//! until the next call to getPkt.
 
 //! @return  bool:      TRUE to indicate success, FALSE otherwise (means a
 //!                     communications failure)
@@ -48,22 +50,52 @@ using namespace EmbDebug;
 std::pair<bool, RspPacket> AbstractConnection::getPkt() {
   RspPacketBuilder newPkt;
 
+  // The last packet we returned is finished with. Make sure the receive
+  // buffers can hold a whole packet.
+  mRxPinned = false;
+  std::size_t rxSize = RspPacket::getMaxPacketSize() + 3;
+
+  if (mRxBuf.size() < rxSize) {
+    mRxBuf.resize(rxSize);
+    mRxSpare.resize(rxSize);
+  }
+
   // Keep getting packets, until one is found with a valid checksum
   while (true) {
     unsigned char checksum; // The checksum we have computed
     int ch;                 // Current character
 
-    // Wait around for the start character ('$'). Ignore all other
-    // characters
+    // Wait around for the start character ('$'). Acknowledgements for
+    // packets we have sent may arrive first. Ignore all other characters
     ch = getRspChar();
     while (ch != '$') {
       if (-1 == ch) {
         return {false, RspPacket()}; // Connection failed
+      } else if ((('+' == ch) || ('-' == ch)) && !handleAck(ch)) {
+        return {false, RspPacket()}; // Comms failure
       } else {
         ch = getRspChar();
       }
     }
 
+    // The client has moved on, so it has had everything we sent.
+    discardUnacked();
+
+    // Take the packet from where it is if we can.
+    RspPacket inPlacePkt;
+
+    if (takePktInPlace(inPlacePkt)) {
+      if (!mNoAckMode && !putRspChar('+')) {
+        return {false, RspPacket()}; // Comms failure
+      }
+
+      if (traceFlags->traceRsp()) {
+        cout << "RSP trace: getPkt: " << inPlacePkt << endl;
+      }
+
+      return {true, std::move(inPlacePkt)};
+    }
+
     // Read until a '#' or end of buffer is found
     checksum = 0;
     while (newPkt.getRemaining()) {
@@ -154,80 +186,220 @@ std::pair<bool, RspPacket> AbstractConnection::getPkt() {
 //! are escaped by preceding them with '}' and then XORing the character with
 //! 0x20.
 
+//! If enabled, runs of a repeated char are compressed as the char, followed
+//! by a '*' and a repeat count.
+
+//! The whole packet is framed into the transmit buffer first, so that it can
+//! be sent (and if necessary resent) with a single write.
+
+//! Unless acknowledgements are off, the packet is kept until the client
+//! acknowledges it. Over a reliable transport we don't wait for that, since
+//! the client handles our packets in order, and acknowledgements are picked
+//! up as they arrive. Otherwise we wait for each packet to be acknowledged
+//! before returning.
+
 //! @param[in] pkt  The Packet to transmit
 
 //! @return  TRUE to indicate success, FALSE otherwise (means a communications
 //!          failure).
 bool AbstractConnection::putPkt(const RspPacket &pkt) {
-  std::size_t len = pkt.getLen();
-  int ch; // Ack char
+  // Without acknowledgements, nothing need be kept for sending again.
+  if (mNoAckMode)
+    discardUnacked();
 
-  // Construct $<packet info>#<checksum>. Repeat until the GDB client
-  // acknowledges satisfactory receipt.
-  do {
-    unsigned char checksum = 0; // Computed checksum
-    std::size_t count = 0;      // Index into the buffer
+  std::size_t start = mTxBuf.size();
+  framePkt(pkt);
+  std::size_t len = mTxBuf.size() - start;
 
-    if (!putRspChar('$')) // Start char
-    {
+  // Send $<packet info>#<checksum>.
+  if (!putRspBytesRaw(&mTxBuf[start], len)) {
+    return false; // Comms failure
+  }
+
+  if (!mNoAckMode) {
+    mTxPktLens.push_back(len);
+
+    if (!processAcks()) {
       return false; // Comms failure
     }
+  }
 
-    // Body of the packet
-    for (count = 0; count < len; count++) {
-      unsigned char ch = pkt.getData()[count];
+  if (traceFlags->traceRsp()) {
+    cout << "RSP trace: putPkt: " << pkt << endl;
+  }
 
-      // Check for escaped chars
-      if (('$' == ch) || ('#' == ch) || ('*' == ch) || ('}' == ch)) {
-        ch ^= 0x20;
-        checksum += (unsigned char)'}';
-        if (!putRspChar('}')) {
-          return false; // Comms failure
-        }
-      }
+  return true;
+}
 
-      checksum += ch;
-      if (!putRspChar(ch)) {
-        return false; // Comms failure
-      }
-    }
+//! Frame a packet into the transmit buffer
 
-    if (!putRspChar('#')) // End char
-    {
-      return false; // Comms failure
-    }
+//! Builds $<escaped packet data>#<checksum> at the end of mTxBuf. Each run
+//! of chars needing no escape is found and summed in one pass, then copied
+//! in one go.
 
-    // Computed checksum
-    if (!putRspChar(Utils::hex2Char(checksum >> 4))) {
-      return false; // Comms failure
+//! @param[in] pkt  The Packet to frame
+
+void AbstractConnection::framePkt(const RspPacket &pkt) {
+  const char *data = pkt.getRawData();
+  std::size_t len = pkt.getLen();
+  unsigned char checksum = 0; // Computed checksum
+  std::size_t count = 0;
+
+  // Worst case every char is escaped, plus the framing chars.
+  mTxBuf.reserve(mTxBuf.size() + len * 2 + 4);
+
+  mTxBuf.push_back('$'); // Start char
+
+  // Body of the packet
+  while (count < len) {
+    std::size_t run = Utils::rspScanEscape(&data[count], len - count, checksum);
+
+    if (mRunLengthEncode)
+      frameRun(&data[count], run, checksum);
+    else
+      mTxBuf.insert(mTxBuf.end(), &data[count], &data[count + run]);
+
+    count += run;
+
+    // Escape the char which stopped the scan
+    if (count < len) {
+      char ch = data[count++] ^ 0x20;
+      checksum += (unsigned char)'}' + (unsigned char)ch;
+      mTxBuf.push_back('}');
+      mTxBuf.push_back(ch);
     }
-    if (!putRspChar(Utils::hex2Char(checksum % 16))) {
-      return false; // Comms failure
+  }
+
+  mTxBuf.push_back('#'); // End char
+
+  // Computed checksum
+  mTxBuf.push_back(Utils::hex2Char(checksum >> 4));
+  mTxBuf.push_back(Utils::hex2Char(checksum % 16));
+}
+
+//! Frame a run of chars needing no escape, compressing repeated chars
+
+//! A char repeated n more times is sent as the char, '*' and the char for n
+//! + 29. That char must be printable, and not '#' or '$', so a long run may
+//! take several goes. Short runs are sent as they are, since compressing
+//! them would save nothing.
+
+//! @param[in]     data      The chars to frame
+//! @param[in]     len       The number of chars
+//! @param[in,out] checksum  The checksum, which already includes all the
+//!                          chars. Corrected for the chars actually sent.
+
+void AbstractConnection::frameRun(const char *data, std::size_t len,
+                                  unsigned char &checksum) {
+  std::size_t pos = 0;
+
+  while (pos < len) {
+    char ch = data[pos];
+    std::size_t end = pos + 1;
+
+    while ((end < len) && (data[end] == ch))
+      end++;
+
+    std::size_t remaining = end - pos; // Copies of ch still to send
+    pos = end;
+
+    while (remaining > 0) {
+      mTxBuf.push_back(ch);
+      remaining--;
+
+      std::size_t repeats =
+          (remaining < MAX_RLE_REPEATS) ? remaining : MAX_RLE_REPEATS;
+
+      if ((repeats == 6) || (repeats == 7))
+        repeats = 5; // Counts of '#' and '$' are not allowed
+
+      if (repeats >= MIN_RLE_REPEATS) {
+        char countCh = static_cast<char>(repeats + 29);
+        mTxBuf.push_back('*');
+        mTxBuf.push_back(countCh);
+        checksum += (unsigned char)'*' + (unsigned char)countCh -
+                    repeats * (unsigned char)ch;
+        remaining -= repeats;
+      }
     }
+  }
+}
 
-    // Check for ack of connection failure
-    if (mNoAckMode)
-      break;
-    ch = getRspChar();
-    if (-1 == ch) {
-      return false; // Comms failure
+//! Pick up acknowledgements for the packets we have sent
+
+//! Acknowledgements are taken from the head of the input for as long as any
+//! of our packets are unacknowledged. A break found among them is noted for
+//! haveBreak. We only wait for more input if too many packets are
+//! unacknowledged, which over an unreliable transport is any at all.
+
+//! @return  TRUE unless there was a communications failure.
+
+bool AbstractConnection::processAcks() {
+  std::size_t maxUnacked = isReliable() ? MAX_UNACKED_PKTS : 0;
+
+  while (!mTxPktLens.empty()) {
+    bool mustWait = mTxPktLens.size() > maxUnacked;
+
+    if ((mRxPos == mRxEnd) && !fillRxBuf(mustWait))
+      return !mustWait;
+
+    char ch = mRxBuf[mRxPos];
+
+    if (('+' == ch) || ('-' == ch)) {
+      mRxPos++;
+
+      if (!handleAck(ch))
+        return false;
     } else if (BREAK_CHAR == ch) {
       // Handle a break arriving while we're waiting for a packet ACK.
-      // We only support the arrival of a single break, which I think
-      // is acceptable.
+      mRxPos++;
       mHavePendingBreak = true;
-      ch = getRspChar();
-      assert(ch != BREAK_CHAR);
-    }
-  } while ('+' != ch);
-
-  if (traceFlags->traceRsp()) {
-    cout << "RSP trace: putPkt: " << pkt << endl;
+    } else
+      return true; // Leave anything else, such as a packet, for getPkt
   }
 
   return true;
 }
 
+//! Act on an acknowledgement from the client
+
+//! A '+' acknowledges our oldest outstanding packet. A '-' means it was
+//! corrupted, so it, and everything sent after it, is sent again in order.
+
+//! @param[in] ch  The acknowledgement char ('+' or '-')
+//! @return  TRUE unless there was a communications failure.
+
+bool AbstractConnection::handleAck(char ch) {
+  // Ignore stray acknowledgements, such as the one GDB sends for our reply
+  // to QStartNoAckMode.
+  if (mTxPktLens.empty())
+    return true;
+
+  if ('+' == ch) {
+    mTxStart += mTxPktLens.front();
+    mTxPktLens.pop_front();
+
+    if (mTxPktLens.empty())
+      discardUnacked();
+
+    return true;
+  }
+
+  if (traceFlags->traceRsp())
+    cout << "RSP trace: resending " << mTxPktLens.size() << " packet(s)"
+         << endl;
+
+  return putRspBytesRaw(&mTxBuf[mTxStart], mTxBuf.size() - mTxStart);
+}
+
+//! Forget all the packets awaiting acknowledgement
+
+void AbstractConnection::discardUnacked() {
+  mTxBuf.clear();
+  mTxStart = 0;
+  mTxPktLens.clear();
+}
+
 //! Put a single character out on the RSP connection
 
 //! Potentially we can have an OS specific implemenation of the underlying
@@ -238,33 +410,188 @@ bool AbstractConnection::putPkt(const RspPacket &pkt) {
 
 bool AbstractConnection::putRspChar(char c) { return putRspCharRaw(c); }
 
-//! Get a single character from the RSP connection with buffering
+//! Put a buffer of characters out on the RSP connection
+
+//! Default implementation for connections which only provide a single
+//! character write. Connections which can do better should override this.
 
-//! Utility routine for use by other functions.  This is built on the raw
-//! read function.
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+//! @return  TRUE if all chars were sent OK, FALSE if not (communications
+//!          failure)
 
-//! This function will first return the possibly buffered character (buffering
-//! caused by calling 'haveBreak'.
+bool AbstractConnection::putRspBytesRaw(const char *buf, std::size_t len) {
+  for (std::size_t i = 0; i < len; i++)
+    if (!putRspCharRaw(buf[i]))
+      return false;
+
+  return true;
+}
+
+//! Get a single character from the RSP connection with buffering
+
+//! Utility routine for use by other functions.  Characters are handed out
+//! from the receive buffer, which is refilled with a single blocking read of
+//! as many characters as the OS has available when it runs dry.
 
 //! @return  The character received or -1 on failure
 
 int AbstractConnection::getRspChar() {
-  int ch;
+  // It's tempting to think we can check for BREAK_CHAR here.  DON'T!  This
+  // method is used when reading in whole packets, and the BREAK_CHAR is only
+  // special when it arrives outside of a packet.
+  if ((mRxPos == mRxEnd) && !fillRxBuf(true))
+    return -1;
 
-  if (mNumGetBufChars > 1)
-    cerr << "Warning: Too many cached characters (" << dec << mNumGetBufChars
-         << ")" << endl;
+  return mRxBuf[mRxPos++] & 0xff; // No sign extend!
+}
 
-  if (mNumGetBufChars > 0) {
-    ch = mGetCharBuf;
-    mNumGetBufChars = 0;
-  } else
-    // It's tempting to think we can check for BREAK_CHAR here.  DON'T!
-    // This method is used when reading in whole packets, and the
-    // BREAK_CHAR is only special when it arrives outside of a packet.
-    ch = getRspCharRaw(true);
+//! Refill the receive buffer
+
+//! Only called when the buffer is empty, so we can always start filling from
+//! the beginning, unless the buffer holds a packet still in use.
+
+//! @param[in] blocking  True if the read should block.
+//! @return  TRUE if at least one character was read, FALSE on failure or if
+//!          the read would block and blocking is false.
+
+bool AbstractConnection::fillRxBuf(bool blocking) {
+  assert(mRxPos == mRxEnd);
+
+  // Leave a packet taken in place alone, and read into the spare buffer.
+  if (mRxPinned) {
+    std::swap(mRxBuf, mRxSpare);
+    mRxPinned = false;
+  }
+
+  int count = getRspBytesRaw(mRxBuf.data(), mRxBuf.size(), blocking);
+  mRxPos = 0;
+  mRxEnd = (count > 0) ? static_cast<std::size_t>(count) : 0;
+
+  return count > 0;
+}
+
+//! Take a packet straight from the receive buffer
+
+//! Called once the '$' starting a packet has been consumed. If the rest of
+//! the packet is not yet in the receive buffer, we read until it is,
+//! moving what we have to the start of the buffer if needed. The packet's
+//! '#' is overwritten with a zero byte, so the packet is zero terminated
+//! in place, and the buffer is pinned so that it is not reused while the
+//! packet may be in use. The checksum is computed as we look for the '#',
+//! so each char is only looked at once.
+
+//! Anything unusual (a packet too big for the buffer, a '$' restarting the
+//! packet, a bad checksum or a failed read) is left to be handled one char
+//! at a time by getPkt. Nothing is consumed in that case.
+
+//! @param[out] pkt  The packet, referring to the receive buffer.
+//! @return  TRUE if a packet was taken, FALSE otherwise.
 
-  return ch;
+bool AbstractConnection::takePktInPlace(RspPacket &pkt) {
+  std::size_t maxLen = RspPacket::getMaxPacketSize();
+  std::size_t scanPos = mRxPos; // Where to resume looking for '#'
+  std::size_t hashPos;
+  unsigned char checksum = 0; // Checksum of the chars before scanPos
+
+  while (true) {
+    scanPos += Utils::rspScanPacket(&mRxBuf[scanPos], mRxEnd - scanPos,
+                                    checksum);
+
+    if (scanPos < mRxEnd) {
+      if ('$' == mRxBuf[scanPos])
+        return false; // Packet restarted
+
+      hashPos = scanPos;
+
+      if ((hashPos + 3) <= mRxEnd)
+        break; // Checksum is here too
+    }
+
+    if ((scanPos - mRxPos) > maxLen)
+      return false; // Too long
+
+    // Make room for more at the end of the buffer
+    if (mRxPos > 0) {
+      std::size_t avail = mRxEnd - mRxPos;
+      memmove(mRxBuf.data(), &mRxBuf[mRxPos], avail);
+      scanPos -= mRxPos;
+      mRxPos = 0;
+      mRxEnd = avail;
+    }
+
+    if (mRxEnd == mRxBuf.size())
+      return false;
+
+    int count =
+        getRspBytesRaw(&mRxBuf[mRxEnd], mRxBuf.size() - mRxEnd, true);
+
+    if (count <= 0)
+      return false;
+
+    mRxEnd += static_cast<std::size_t>(count);
+  }
+
+  char *data = &mRxBuf[mRxPos];
+  std::size_t len = hashPos - mRxPos;
+
+  if (len > maxLen)
+    return false;
+
+  if (!Utils::isHexStr(&mRxBuf[hashPos + 1], 2))
+    return false;
+
+  unsigned char xmitcsum = (Utils::char2Hex(mRxBuf[hashPos + 1]) << 4) +
+                           Utils::char2Hex(mRxBuf[hashPos + 2]);
+
+  if (!mNoAckMode && (checksum != xmitcsum))
+    return false;
+
+  mRxBuf[hashPos] = 0;
+  mRxPos = hashPos + 3;
+  mRxPinned = true;
+  pkt = RspPacket::CreateView(data, len);
+  return true;
+}
+
+//! Read as many characters as are available from the RSP connection
+
+//! Default implementation for connections which only provide a single
+//! character read. Connections which can do better should override this.
+
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer (must be at least 1)
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters read or -1 on failure, or if the read
+//!          would block and blocking is false.
+
+int AbstractConnection::getRspBytesRaw(char *buf, std::size_t len,
+                                       bool blocking) {
+  assert(len > 0);
+  int ch = getRspCharRaw(blocking);
+
+  if (-1 == ch)
+    return -1;
+
+  buf[0] = static_cast<char>(ch);
+  return 1;
+}
+
+//! Forget the client we were connected to
+
+//! Input it sent which we have not consumed, a break it sent, and packets it
+//! has not acknowledged would otherwise be taken as belonging to the next
+//! client. Each new client also starts with acknowledgements on.
+
+//! Transports which can reconnect call this when a client connects and when
+//! it is closed.
+
+void AbstractConnection::resetClientState() {
+  mRxPos = 0;
+  mRxEnd = 0;
+  mRxPinned = false;
+  mHavePendingBreak = false;
+  setNoAckMode(false);
 }
 
 //! Have we received a break character.
@@ -272,22 +599,23 @@ int AbstractConnection::getRspChar() {
 //! Since we only check fo this between packets, we don't have to worry about
 //! being in the middle of a packet.
 
-//! @Note  We only peek, so no character is actually consumed from the input.
+//! @Note  We only peek, so no character other than a break is consumed from
+//!        the input.
 
 //! @return  TRUE if we have received a break character, FALSE otherwise.
 
 bool AbstractConnection::haveBreak() {
-  if (!mHavePendingBreak && mNumGetBufChars == 0) {
-    // Non-blocking read to possibly get a character.
+  if (!mHavePendingBreak) {
+    // Acknowledgements for packets we have sent may be ahead of a break.
+
+    (void)processAcks();
 
-    int nextChar = getRspCharRaw(false);
+    // Non-blocking read to possibly get some characters.
 
-    if (nextChar != -1) {
-      if (nextChar == BREAK_CHAR)
+    if ((mRxPos < mRxEnd) || fillRxBuf(false)) {
+      if (BREAK_CHAR == mRxBuf[mRxPos]) {
+        mRxPos++;
         mHavePendingBreak = true;
-      else {
-        mGetCharBuf = nextChar;
-        mNumGetBufChars = 1;
       }
     }
   }
@@ -9,6 +9,9 @@
 #ifndef ABSTRACT_CONNECTION_H
 #define ABSTRACT_CONNECTION_H
 
+#include <deque>
+#include <vector>
+
 #include "RspPacket.h"
 #include "TraceFlags.h"
 
@@ -32,6 +35,30 @@ public:
   virtual void rspClose() = 0;
   virtual bool isConnected() = 0;
 
+  // File descriptor which becomes readable when the client sends data, or -1
+  // if the connection cannot provide one.
+
+  virtual int getFd() { return -1; }
+
+  // Does the transport deliver every character intact and in order? If so,
+  // we need not wait for each packet to be acknowledged before sending the
+  // next, and the client may turn acknowledgements off altogether.
+  //
+  // Every transport we ship (sockets, pipes and the shared memory ring) is
+  // reliable, so in practice QStartNoAckMode is always offered, and
+  // waiting for each acknowledgement is only seen with the test doubles.
+  // The default stays cautious for transports which may lose characters,
+  // such as a serial line.
+
+  virtual bool isReliable() { return false; }
+
+  // The largest packet worth using on this transport, used as the maximum
+  // packet size unless the user sets one.
+
+  virtual std::size_t preferredPacketSize() {
+    return isReliable() ? LARGE_PKT_SIZE : SMALL_PKT_SIZE;
+  }
+
   // Public interface: get packets from the stream and put them out
 
   virtual std::pair<bool, RspPacket> getPkt();
@@ -41,24 +68,70 @@ public:
 
   virtual bool haveBreak();
 
+  // Is there input we have read from the client but not yet consumed?
+
+  bool hasBufferedInput() const { return mRxPos < mRxEnd; }
+
   // Disable packet acknowledgements
-  void setNoAckMode(bool ackMode) { mNoAckMode = ackMode; }
+  void setNoAckMode(bool ackMode) {
+    mNoAckMode = ackMode;
+    discardUnacked();
+  }
+
+  // Compress runs of repeated chars in the packets we send
+  void setRunLengthEncoding(bool rle) { mRunLengthEncode = rle; }
 
 protected:
   //! Trace flags
 
   TraceFlags *traceFlags;
 
+  // Forget the client we were connected to, ready for the next one
+
+  void resetClientState();
+
   // Internal OS specific routines to handle individual chars.
 
   virtual bool putRspCharRaw(char c) = 0;
   virtual int getRspCharRaw(bool blocking) = 0;
 
+  // Internal OS specific routines to write a whole buffer and to read as many
+  // chars as are available. The default implementations are built on the
+  // single char routines.
+
+  virtual bool putRspBytesRaw(const char *buf, std::size_t len);
+  virtual int getRspBytesRaw(char *buf, std::size_t len, bool blocking);
+
 private:
   //! The BREAK character
 
   static const int BREAK_CHAR = 3;
 
+  //! Size of the receive buffer
+
+  static const std::size_t RX_BUF_SIZE = 16384;
+
+  //! Preferred packet size for transports which may corrupt characters. A
+  //! packet which has to be sent again should not be too long.
+
+  static const std::size_t SMALL_PKT_SIZE = 10000;
+
+  //! Preferred packet size for reliable transports. Big enough that large
+  //! memory transfers take few packets.
+
+  static const std::size_t LARGE_PKT_SIZE = 0x20000;
+
+  //! Most packets we will send over a reliable transport before waiting for
+  //! the client to acknowledge them.
+
+  static const std::size_t MAX_UNACKED_PKTS = 32;
+
+  //! Fewest and most repeats of a char which can be run length encoded. The
+  //! repeat count is sent as a printable char (count + 29).
+
+  static const std::size_t MIN_RLE_REPEATS = 3;
+  static const std::size_t MAX_RLE_REPEATS = 97;
+
   //! Has a BREAK arrived?
 
   bool mHavePendingBreak;
@@ -67,16 +140,61 @@ private:
 
   bool mNoAckMode;
 
-  //! The buffered char for get RspChar
-  int mGetCharBuf;
+  //! Are runs of repeated chars compressed in the packets we send?
+
+  bool mRunLengthEncode;
+
+  //! Receive buffer, holding chars read from the OS but not yet consumed
+
+  std::vector<char> mRxBuf;
+
+  //! Offset of the next unconsumed char in the receive buffer
+
+  std::size_t mRxPos;
+
+  //! Offset one past the last valid char in the receive buffer
+
+  std::size_t mRxEnd;
+
+  //! Spare receive buffer. While a packet taken in place from the receive
+  //! buffer may still be in use, more input is read into this one instead,
+  //! by swapping the two.
 
-  //! Count of how many buffered chars we have
-  int mNumGetBufChars;
+  std::vector<char> mRxSpare;
+
+  //! Does the receive buffer hold a packet which may still be in use?
+
+  bool mRxPinned;
+
+  //! Transmit buffer, holding the framed packets which the client has not
+  //! yet acknowledged, in case they must be sent again. Reused to avoid
+  //! repeated allocation.
+
+  std::vector<char> mTxBuf;
+
+  //! Offset of the oldest unacknowledged packet in the transmit buffer
+
+  std::size_t mTxStart;
+
+  //! Length of each unacknowledged packet in the transmit buffer, oldest
+  //! first
+
+  std::deque<std::size_t> mTxPktLens;
 
   // Internal routines to handle individual chars
 
   bool putRspChar(char c);
   int getRspChar();
+  bool fillRxBuf(bool blocking);
+  bool takePktInPlace(RspPacket &pkt);
+  void framePkt(const RspPacket &pkt);
+  void frameRun(const char *data, std::size_t len, unsigned char &checksum);
+
+  // Internal routines to handle acknowledgements
+
+  bool processAcks();
+  bool handleAck(char ch);
+  void discardUnacked();
 };
 
 // Default implementation of the destructor.
@@ -85,7 +203,8 @@ inline AbstractConnection::~AbstractConnection() {}
 
 inline AbstractConnection::AbstractConnection(TraceFlags *_traceFlags)
     : traceFlags(_traceFlags), mHavePendingBreak(false), mNoAckMode(false),
-      mNumGetBufChars(0) {}
+      mRunLengthEncode(false), mRxBuf(RX_BUF_SIZE), mRxPos(0), mRxEnd(0),
+      mRxSpare(RX_BUF_SIZE), mRxPinned(false), mTxStart(0) {}
 
 } // namespace EmbDebug
 
@@ -0,0 +1,146 @@
+// Readiness-driven event loop: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+#include "EventLoop.h"
+
+using std::cerr;
+using std::endl;
+
+using namespace EmbDebug;
+
+//! Constructor
+
+//! On Linux, create the epoll instance. Failure is not fatal, it just means
+//! the loop is invalid.
+
+EventLoop::EventLoop() : mEpollFd(-1), mFds() {
+#if defined(__linux__)
+  mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (-1 == mEpollFd)
+    cerr << "Warning: Failed to create epoll instance: " << strerror(errno)
+         << endl;
+#endif
+}
+
+//! Destructor
+
+//! Close the epoll instance if we have one.
+
+EventLoop::~EventLoop() {
+#if defined(__linux__)
+  if (-1 != mEpollFd)
+    close(mEpollFd);
+#endif
+}
+
+//! Is the loop usable on this host?
+
+//! @return  TRUE if file descriptors can be waited on, FALSE otherwise.
+
+bool EventLoop::isValid() const {
+#if defined(__linux__)
+  return -1 != mEpollFd;
+#elif !defined(_WIN32)
+  return true;
+#else
+  return false;
+#endif
+}
+
+//! Add a file descriptor to watch for readability
+
+//! @param[in] fd  The file descriptor to watch
+//! @return  TRUE if the file descriptor was added, FALSE otherwise.
+
+bool EventLoop::add(int fd) {
+  if (!isValid() || (fd < 0))
+    return false;
+
+#if defined(__linux__)
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+
+  if (-1 == epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev)) {
+    cerr << "Warning: Failed to add fd " << fd
+         << " to epoll instance: " << strerror(errno) << endl;
+    return false;
+  }
+#endif
+
+  mFds.push_back(fd);
+  return true;
+}
+
+//! Stop watching all file descriptors
+
+//! File descriptors may change (for example on reconnection), so callers
+//! should clear the set once they have finished waiting.
+
+void EventLoop::clear() {
+#if defined(__linux__)
+  // A file descriptor which has since been closed is removed from the epoll
+  // set automatically, so ignore any failure here.
+  for (int fd : mFds)
+    (void)epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+  mFds.clear();
+}
+
+//! Wait for any watched file descriptor to become readable
+
+//! @param[in] timeoutMs  Maximum time to wait in milliseconds, or -1 to wait
+//!                       for ever.
+//! @return  The number of file descriptors ready, 0 on timeout or
+//!          interrupt, or -1 on error.
+
+int EventLoop::wait(int timeoutMs) {
+  if (!isValid() || mFds.empty())
+    return -1;
+
+#if defined(__linux__)
+  struct epoll_event events[4];
+  int res = epoll_wait(mEpollFd, events, sizeof(events) / sizeof(events[0]),
+                       timeoutMs);
+#elif !defined(_WIN32)
+  std::vector<struct pollfd> pfds;
+  for (int fd : mFds) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    pfds.push_back(pfd);
+  }
+  int res = poll(pfds.data(), pfds.size(), timeoutMs);
+#else
+  int res = -1;
+  (void)timeoutMs;
+#endif
+
+  if (-1 == res) {
+    if (EINTR == errno)
+      return 0;
+
+    cerr << "Warning: Failed to wait for events: " << strerror(errno) << endl;
+  }
+
+  return res;
+}
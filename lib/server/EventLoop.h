@@ -0,0 +1,59 @@
+// Readiness-driven event loop: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <vector>
+
+namespace EmbDebug {
+
+//! Class to wait for any of a set of file descriptors to become readable.
+
+//! On Linux this is built on epoll, and on other POSIX hosts on poll. Where
+//! neither is available the loop is invalid, and callers should fall back to
+//! polling.
+
+class EventLoop {
+public:
+  // Constructor and destructor
+
+  EventLoop();
+  ~EventLoop();
+
+  // Is the loop usable on this host?
+
+  bool isValid() const;
+
+  // Manage the set of file descriptors we are watching
+
+  bool add(int fd);
+  void clear();
+
+  // Wait for a file descriptor to become readable
+
+  int wait(int timeoutMs);
+
+private:
+  // Don't allow copying, since we own the epoll file descriptor.
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  //! The epoll file descriptor (-1 if not using epoll)
+
+  int mEpollFd;
+
+  //! The file descriptors being watched
+
+  std::vector<int> mFds;
+};
+
+} // namespace EmbDebug
+
+#endif
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <chrono>
 #include <climits>
+#include <cstdio>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -22,7 +23,9 @@
 
 #include "AbstractConnection.h"
 #include "GdbServer.h"
+#include "PacketParser.h"
 #include "SyscallReplyPacket.h"
+#include "TargetLock.h"
 #include "TraceFlags.h"
 #include "Utils.h"
 #include "VContActions.h"
@@ -46,25 +49,77 @@ using namespace EmbDebug;
 //! Allocate a packet data structure and a new RSP connection. By default no
 //! timeout for run/continue.
 
+//! A server may be given a subset of the target's cores, in which case it
+//! only ever resumes or reports those cores, and shares the target with the
+//! servers for the other cores through a TargetLock.
+
 //! @param[in] rspPort      RSP port to use.
 //! @param[in] _cpu         The simulated CPU
 //! @param[in] _data           Data shared with the targets
 //! @param[in] _killBehaviour  How to handle ctrl-C
+//! @param[in] _cores       The cores this server controls. Empty for all.
+//! @param[in] _targetLock  Lock shared with other servers for the same
+//!                         target, or nullptr if there are none.
 
 GdbServer::GdbServer(AbstractConnection *_conn, ITarget *_cpu,
-                     TraceFlags *traceFlags, KillBehaviour _killBehaviour)
-    : cpu(_cpu), traceFlags(traceFlags), rsp(_conn),
-      mNumRegs(cpu->getRegisterCount()), pkt(), mMatchpointMap(),
+                     TraceFlags *traceFlags, KillBehaviour _killBehaviour,
+                     const std::vector<unsigned int> &_cores,
+                     TargetLock *_targetLock)
+    : cpu(_cpu), traceFlags(traceFlags), rsp(_conn), mTargetLock(_targetLock),
+      mCurrentCpu(0), mHaveLockTicket(false), mLockTicket(0),
+      mNumRegs(cpu->getRegisterCount()), pkt(),
+      mMatchpointMap(), mMemCache(_cpu), mPrefetchPc(0), mPrefetchSp(0),
+      mPcRegnum(-1), mSpRegnum(-1),
       killBehaviour(_killBehaviour), mExitServer(false), mHaveMultiProc(false),
-      mStopMode(StopMode::ALL_STOP), mPtid(PID_DEFAULT, TID_DEFAULT),
-      mNextProcess(1), mHandlingSyscall(false), mHaveSyscallArgLocs(false),
-      mHaveSyscallSupport(false), mKillCoreOnExit(false),
-      mCoreManager(cpu->getCpuCount()) {}
+      mHaveErrorMessage(false),
+      mStopMode(StopMode::ALL_STOP), mDefaultPid(PID_DEFAULT),
+      mPtid(PID_DEFAULT, TID_DEFAULT), mNextProcess(1),
+      mHandlingSyscall(false), mHaveSyscallArgLocs(false),
+      mHaveSyscallSupport(false), mKillCoreOnExit(false), mKeepState(false),
+      mCoreManager(cpu->getCpuCount(), _cores) {
+  // Start off looking at the first of our cores.
+  mCurrentCpu = mCoreManager.firstCore();
+  mDefaultPid = CoreManager::coreNum2Pid(mCurrentCpu);
+  mPtid = Ptid(mDefaultPid, TID_DEFAULT);
+}
 
 //! Destructor
 
 GdbServer::~GdbServer() {}
 
+//! Set how much memory to fetch when a core stops
+
+//! Register numbers depend on the architecture, and the target doesn't
+//! tell us them, so there is no prefetching around a register whose number
+//! hasn't been given.
+
+//! Prefetching needs the memory cache, so if it is disabled it is enabled
+//! with lines of DEFAULT_CACHE_LINE bytes.
+
+//! @param[in] pcRegnum  GDB's number for the PC register, or -1 if unknown
+//! @param[in] pcBytes   Bytes of memory to fetch around the PC, or zero
+//! @param[in] spRegnum  GDB's number for the SP register, or -1 if unknown
+//! @param[in] spBytes   Bytes of memory to fetch above the SP, or zero
+//! @return  TRUE if the settings were used, FALSE if memory was to be
+//!          fetched around a register which doesn't exist.
+
+bool GdbServer::setStopPrefetch(int pcRegnum, std::size_t pcBytes,
+                                int spRegnum, std::size_t spBytes) {
+  if (((pcBytes != 0) && ((pcRegnum < 0) || (pcRegnum >= mNumRegs))) ||
+      ((spBytes != 0) && ((spRegnum < 0) || (spRegnum >= mNumRegs))))
+    return false;
+
+  mPcRegnum = pcRegnum;
+  mPrefetchPc = pcBytes;
+  mSpRegnum = spRegnum;
+  mPrefetchSp = spBytes;
+
+  if (((pcBytes != 0) || (spBytes != 0)) && (mMemCache.getLineSize() == 0))
+    (void)mMemCache.setLineSize(DEFAULT_CACHE_LINE);
+
+  return true;
+}
+
 //! Main loop to listen for RSP requests
 
 //! This only terminates if there was an error.
@@ -86,8 +141,10 @@ int GdbServer::rspServer() {
       // exited even over a disconnect and reconnect... but I'm
       // guessing that in most cases a disconnect and reconnect implies
       // that we're starting again with the target and would like all
-      // cores to spring back to life.
-      mCoreManager.reset();
+      // cores to spring back to life.  If not, the user can ask for the
+      // state to be kept.
+      if (!mKeepState)
+        mCoreManager.reset();
     }
 
     // Get a RSP client request
@@ -103,7 +160,7 @@ int GdbServer::rspServer() {
 int GdbServer::stringLength(uint_addr_t addr) {
   uint8_t ch;
   int count = 0;
-  while (1 == cpu->read(addr + count, &ch, 1)) {
+  while (1 == mMemCache.read(addr + count, &ch, 1)) {
     count++;
     if (ch == 0)
       break;
@@ -127,7 +184,7 @@ uint_reg_t GdbServer::readArgLoc(const ITarget::SyscallArgLoc &loc) {
     // read and return the memory
     std::size_t byteSize = cpu->getRegisterSize();
     uint8_t buf[sizeof(uint_reg_t)];
-    size_t ret = cpu->read(addr, buf, byteSize);
+    size_t ret = mMemCache.read(addr, buf, byteSize);
     assert(ret == byteSize);
 
     uint_reg_t value = 0;
@@ -166,52 +223,65 @@ void GdbServer::rspSyscallRequest() {
   // Get the syscall id from the appropriate location
   uint_reg_t syscallID = readArgLoc(mSyscallIDLoc);
 
-  // Store for the values of each argument in turn as they are read
-  std::vector<uint_reg_t> args;
+  // Store for the values of each argument in turn as they are read. The
+  // request is built up from them.
+  uint_reg_t args[3];
+  RspPacketBuilder request;
+  auto readArgs = [this, &args](int count) {
+    for (int i = 0; i < count; ++i)
+      args[i] = readArgLoc(mSyscallArgLocs[i]);
+  };
+  auto addArgs = [&args, &request](int count) {
+    for (int i = 0; i < count; ++i) {
+      request += ',';
+      request.addHex(args[i]);
+    }
+  };
+
   switch (syscallID) {
   case 57:
-    args.push_back(readArgLoc(mSyscallArgLocs[0]));
-    rsp->putPkt(RspPacket::CreateFormatted("Fclose,%" PRIxREG, args[0]));
+    readArgs(1);
+    request += "Fclose";
+    addArgs(1);
+    rsp->putPkt(request);
     return;
   case 62:
-    for (int i = 0; i < 3; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted("Flseek,%" PRIxREG ",%" PRIxREG
-                                           ",%" PRIxREG,
-                                           args[0], args[1], args[2]));
+    readArgs(3);
+    request += "Flseek";
+    addArgs(3);
+    rsp->putPkt(request);
     return;
   case 63:
-    for (int i = 0; i < 3; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted("Fread,%" PRIxREG ",%" PRIxREG
-                                           ",%" PRIxREG,
-                                           args[0], args[1], args[2]));
+    readArgs(3);
+    request += "Fread";
+    addArgs(3);
+    rsp->putPkt(request);
     return;
   case 64:
-    for (int i = 0; i < 3; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted("Fwrite,%" PRIxREG ",%" PRIxREG
-                                           ",%" PRIxREG,
-                                           args[0], args[1], args[2]));
+    readArgs(3);
+    request += "Fwrite";
+    addArgs(3);
+    rsp->putPkt(request);
     return;
   case 80:
-    for (int i = 0; i < 2; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted("Ffstat,%" PRIxREG ",%" PRIxREG,
-                                           args[0], args[1]));
+    readArgs(2);
+    request += "Ffstat";
+    addArgs(2);
+    rsp->putPkt(request);
     return;
   case 93: {
     if (traceFlags->traceExec())
       cerr << "EXIT syscall on core " << cpu->getCurrentCpu()
            << " halting all other cores." << endl;
     (void)cpu->halt();
-    args.push_back(readArgLoc(mSyscallArgLocs[0]));
-    if (mHaveMultiProc)
-      rsp->putPkt(RspPacket::CreateFormatted(
-          "W%" PRIxREG ";process:%x", args[0],
-          CoreManager::coreNum2Pid(cpu->getCurrentCpu())));
-    else
-      rsp->putPkt(RspPacket::CreateFormatted("W%" PRIxREG, args[0]));
+    readArgs(1);
+    request += 'W';
+    request.addHex(args[0]);
+    if (mHaveMultiProc) {
+      request += ";process:";
+      request.addHex(CoreManager::coreNum2Pid(cpu->getCurrentCpu()));
+    }
+    rsp->putPkt(request);
     /* We never get a reply from an exit syscall, so don't
        store a continuation state.  */
     mHandlingSyscall = false;
@@ -220,29 +290,40 @@ void GdbServer::rspSyscallRequest() {
     return;
   }
   case 169:
-    for (int i = 0; i < 2; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted(
-        "Fgettimeofday,%" PRIxREG ",%" PRIxREG, args[0], args[1]));
+    readArgs(2);
+    request += "Fgettimeofday";
+    addArgs(2);
+    rsp->putPkt(request);
     return;
   case 1024:
-    for (int i = 0; i < 3; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted(
-        "Fopen,%" PRIxREG "/%x,%" PRIxREG ",%" PRIxREG, args[0],
-        stringLength(args[0]), args[1], args[2]));
+    readArgs(3);
+    request += "Fopen,";
+    request.addHex(args[0]);
+    request += '/';
+    request.addHex(stringLength(args[0]));
+    request += ',';
+    request.addHex(args[1]);
+    request += ',';
+    request.addHex(args[2]);
+    rsp->putPkt(request);
     return;
   case 1026:
-    args.push_back(readArgLoc(mSyscallArgLocs[0]));
-    rsp->putPkt(RspPacket::CreateFormatted("Funlink,%" PRIxREG "/%x", args[0],
-                                           stringLength(args[0])));
+    readArgs(1);
+    request += "Funlink,";
+    request.addHex(args[0]);
+    request += '/';
+    request.addHex(stringLength(args[0]));
+    rsp->putPkt(request);
     return;
   case 1038:
-    for (int i = 0; i < 2; ++i)
-      args.push_back(readArgLoc(mSyscallArgLocs[i]));
-    rsp->putPkt(RspPacket::CreateFormatted("Fstat,%" PRIxREG "/%x,%" PRIxREG,
-                                           args[0], stringLength(args[0]),
-                                           args[1]));
+    readArgs(2);
+    request += "Fstat,";
+    request.addHex(args[0]);
+    request += '/';
+    request.addHex(stringLength(args[0]));
+    request += ',';
+    request.addHex(args[1]);
+    rsp->putPkt(request);
     return;
 
   default:
@@ -317,9 +398,25 @@ void GdbServer::doCoreActions(void) {
 
   mTimeout.timeStamp(cpu);
 
+  // Another session may have prepared the target since we did, so make sure
+  // it will carry out our actions.
+  if (mTargetLock && !cpu->prepare(mCoreManager.resumeActions()))
+    Utils::fatalError("Failed to prepare target");
+
+  // Once the cores run, nothing we hold of memory can be trusted.
+  mMemCache.flush();
+
   if (!cpu->resume())
     Utils::fatalError("Failed to resume target");
 
+  // If the target can tell us when it stops, we can sleep until either the
+  // target or the client needs attention, rather than polling.
+  bool haveEvents = mEventLoop.add(cpu->getWakeupFd());
+  haveEvents = haveEvents && mEventLoop.add(rsp->getFd());
+  if (!haveEvents)
+    mEventLoop.clear();
+  bool watchingClient = haveEvents;
+
   // Tell the target to resume this set of actions.
   std::vector<ITarget::ResumeRes> results;
   ITarget::WaitRes waitres;
@@ -334,6 +431,7 @@ void GdbServer::doCoreActions(void) {
       // Force the target to stop. Ignore return value.
       TargetSignal sig;
 
+      mEventLoop.clear();
       if (traceFlags->traceExec())
         cerr << "Break detected in gdbserver, halting all cores" << endl;
       if (!cpu->halt())
@@ -342,8 +440,34 @@ void GdbServer::doCoreActions(void) {
       rspReportException(sig);
       return;
     }
+
+    // If another session is waiting for the target, let it have a turn,
+    // unless one of our cores turns out to have stopped.
+    if (mTargetLock && mTargetLock->contended() && !yieldTarget(results)) {
+      waitres = ITarget::WaitRes::EVENT_OCCURRED;
+      break;
+    }
+
+    // Input other than a break is left buffered until the cores stop, and
+    // nothing more is read from the client until it is consumed, so the
+    // client may stay readable. From then on we only watch the target,
+    // rather than waking straight away every time.
+    if (watchingClient && rsp->hasBufferedInput()) {
+      mEventLoop.clear();
+      haveEvents = mEventLoop.add(cpu->getWakeupFd());
+      watchingClient = false;
+    }
+
+    if (haveEvents) {
+      int interval = mTimeout.pollInterval();
+      if (mTargetLock && (interval < 0 || interval > SHARED_POLL_INTERVAL))
+        interval = SHARED_POLL_INTERVAL;
+      (void)mEventLoop.wait(interval);
+    }
   }
 
+  mEventLoop.clear();
+
   if (waitres == ITarget::WaitRes::ERROR)
     Utils::fatalError("Error returned from call to wait()");
 
@@ -373,6 +497,101 @@ void GdbServer::doCoreActions(void) {
     Utils::fatalError("No stop event processed");
 }
 
+//! Hand the target to another session while our cores are running.
+
+//! The target is halted, and once it is ours again it is resumed with the
+//! same actions. To the other session, our cores appear to be stopped.
+
+//! One of our cores may have stopped by itself (at a breakpoint, or at the
+//! end of a step) just before the halt. Resuming it would lose that stop,
+//! so instead we keep the target, and leave the stop for the caller to
+//! report. Any core the target reports as stopped for a reason other than
+//! NONE is taken to have stopped by itself.
+
+//! @param[out] results  The state of each core, if one of ours stopped.
+//! @return  TRUE if the target was handed over and resumed, FALSE if one of
+//!          our cores stopped, in which case the target is still halted.
+
+bool GdbServer::yieldTarget(std::vector<ITarget::ResumeRes> &results) {
+  if (traceFlags->traceExec())
+    cerr << "Session waiting for target, halting all cores" << endl;
+  if (!cpu->halt())
+    Utils::fatalError("Failed to halt cores");
+
+  ITarget::WaitRes waitres = cpu->wait(results);
+
+  if (waitres == ITarget::WaitRes::ERROR)
+    Utils::fatalError("Error returned from call to wait()");
+
+  if (waitres == ITarget::WaitRes::EVENT_OCCURRED) {
+    // A malformed result is left for the caller to complain about.
+    if (results.size() != mCoreManager.getCpuCount())
+      return false;
+
+    for (unsigned int i = 0; i < mCoreManager.getCpuCount(); ++i)
+      if (mCoreManager[i].isRunning() &&
+          (results[i] != ITarget::ResumeRes::NONE)) {
+        if (traceFlags->traceExec())
+          cerr << "Core " << i << " stopped before yielding target" << endl;
+        return false;
+      }
+  }
+
+  releaseTarget();
+  acquireTarget();
+
+  if (!cpu->prepare(mCoreManager.resumeActions()))
+    Utils::fatalError("Failed to prepare target");
+  if (!cpu->resume())
+    Utils::fatalError("Failed to resume target");
+
+  return true;
+}
+
+//! Take the target, if it is shared with other sessions.
+
+//! If another session has held the target since we released it, it may
+//! have changed the current CPU, so we set it back to ours. It may also have
+//! changed memory, so we forget what we hold.
+
+void GdbServer::acquireTarget() {
+  if (mTargetLock) {
+    unsigned long ticket = mTargetLock->lock();
+
+    if (!mHaveLockTicket || (ticket != mLockTicket + 1)) {
+      cpu->setCurrentCpu(mCurrentCpu);
+      mMemCache.flush();
+    }
+
+    mLockTicket = ticket;
+    mHaveLockTicket = true;
+  }
+}
+
+//! Make a core the current CPU
+
+//! Cores may not all see the same memory, so we forget what we hold if the
+//! core changes.
+
+//! @param[in] cpuNum  The core to choose
+
+void GdbServer::selectCpu(unsigned int cpuNum) {
+  if (cpuNum == cpu->getCurrentCpu())
+    return;
+
+  mMemCache.flush();
+  cpu->setCurrentCpu(cpuNum);
+}
+
+//! Release the target, if it is shared with other sessions.
+
+void GdbServer::releaseTarget() {
+  if (mTargetLock) {
+    mCurrentCpu = cpu->getCurrentCpu();
+    mTargetLock->unlock();
+  }
+}
+
 //! Extracts the next stop event that we should process by looking
 //! at the current state of mCoreManager.  If an event is found then CPU
 //! and RESUMERES are updated with the number of the cpu, and the reason
@@ -428,7 +647,7 @@ bool GdbServer::processStopEvents(void) {
 
   if (getNextStopEvent(cpuNum, res)) {
     mCoreManager[cpuNum].reportStopReason();
-    cpu->setCurrentCpu(cpuNum);
+    selectCpu(cpuNum);
     switch (res) {
     case ITarget::ResumeRes::SYSCALL:
       // @todo this change of current cpu here is probably dangerous, after
@@ -443,19 +662,19 @@ bool GdbServer::processStopEvents(void) {
       if (traceFlags->traceExec())
         cerr << "processStopEvent: INTERRUPT (core " << cpuNum << ")" << endl;
       rspReportException();
-      return true;
+      break;
 
     case ITarget::ResumeRes::STEPPED:
       if (traceFlags->traceExec())
         cerr << "processStopEvent: STEPPED (core " << cpuNum << ")" << endl;
       rspReportException(TargetSignal::TRAP);
-      return true;
+      break;
 
     case ITarget::ResumeRes::LOCKSTEP:
       if (traceFlags->traceExec())
         cerr << "processStopEvent: LOCKSTEP (core " << cpuNum << ")" << endl;
       rspReportException(TargetSignal::USR1);
-      return true;
+      break;
 
     default: {
       std::ostringstream fmt_stream;
@@ -463,11 +682,43 @@ bool GdbServer::processStopEvents(void) {
       Utils::fatalError(fmt_stream.str());
     }
     }
+
+    // GDB has the stop, so fetch the memory it will ask for while it deals
+    // with it.
+    prefetchAtStop();
+    return true;
   }
 
   return false;
 }
 
+//! Fetch the memory GDB is likely to read after a stop
+
+//! GDB reads the code around the PC, to disassemble it and to look for
+//! breakpoints, and the stack above the SP, to unwind it. Both are read into
+//! the memory cache together, so those reads need not go to the target. A
+//! quarter of the memory around the PC is before it.
+
+void GdbServer::prefetchAtStop() {
+  std::vector<MemoryCache::Range> ranges;
+  uint_reg_t val;
+
+  if ((mPrefetchPc != 0) && (0 != cpu->readRegister(mPcRegnum, val))) {
+    uint_addr_t pc = static_cast<uint_addr_t>(val);
+    uint_addr_t before = mPrefetchPc / 4;
+
+    ranges.push_back(
+        MemoryCache::Range((pc < before) ? 0 : pc - before, mPrefetchPc));
+  }
+
+  if ((mPrefetchSp != 0) && (0 != cpu->readRegister(mSpRegnum, val)))
+    ranges.push_back(
+        MemoryCache::Range(static_cast<uint_addr_t>(val), mPrefetchSp));
+
+  if (!ranges.empty())
+    mMemCache.prefetch(ranges);
+}
+
 //! Deal with a request from the GDB client session
 
 //! In general, apart from the simplest requests, this function replies on
@@ -487,10 +738,19 @@ void GdbServer::rspClientRequest() {
     return;
   }
 
+  // Only one session may use the target at a time.
+  acquireTarget();
+  rspDispatch();
+  releaseTarget();
+}
+
+//! Act on the request just received from the GDB client session
+
+void GdbServer::rspDispatch() {
   switch (pkt.getData()[0]) {
   case '!':
     // Request for extended remote mode
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
     return;
 
   case '?':
@@ -515,7 +775,7 @@ void GdbServer::rspClientRequest() {
   case 'A':
     // Initialization of argv not supported
     cerr << "Warning: RSP 'A' packet not supported: ignored" << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
 
   case 'b':
@@ -545,7 +805,7 @@ void GdbServer::rspClientRequest() {
     newpkt.addData("vCont;");
     newpkt.addData(pkt.getData());
     pkt = newpkt;
-    rspVpkt();
+    rspVCont();
     return;
   }
 
@@ -558,7 +818,7 @@ void GdbServer::rspClientRequest() {
   case 'D':
     // Detach GDB. Do this by closing the client. The rules say that
     // execution should continue, so unstall the processor.
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
     rsp->rspClose();
     return;
 
@@ -584,28 +844,30 @@ void GdbServer::rspClientRequest() {
 
       // Hc is dprecated - ignore it.
 
-      rsp->putPkt("");
+      rsp->putPkt(RspPacket::EMPTY);
       return;
 
-    case 'g':
+    case 'g': {
 
       // If we are told to choose any process, we choose the default
       // process. Not clear that ALL processes is valid here.
 
-      if (mPtid.decode(&(pkt.getRawData()[strlen("Hg")])) &&
-          mPtid.crystalize(PID_DEFAULT, TID_DEFAULT)) {
-        // Convert process number to core number (using - 1).
-        // @todo method for pid to core mapping.
-        cpu->setCurrentCpu(mPtid.pid() - 1);
-        rsp->putPkt("OK");
+      PacketParser parser(pkt.getData());
+
+      if (parser.expect("Hg") && parser.ptid(mPtid) &&
+          mPtid.crystalize(mDefaultPid, TID_DEFAULT) &&
+          mCoreManager.isCoreOwned(CoreManager::pid2CoreNum(mPtid.pid()))) {
+        selectCpu(CoreManager::pid2CoreNum(mPtid.pid()));
+        rsp->putPkt(RspPacket::OK);
       } else
-        rsp->putPkt("E01");
+        rsp->putPkt(RspPacket::E01);
 
       return;
+    }
 
     default:
 
-      rsp->putPkt("E02");
+      rsp->putPkt(RspPacket::E02);
       return;
     }
 
@@ -648,12 +910,12 @@ void GdbServer::rspClientRequest() {
 
   case 'q':
     // Any one of a number of query packets
-    rspQuery();
+    rspNamedPkt();
     return;
 
   case 'Q':
     // Any one of a number of set packets
-    rspSet();
+    rspNamedPkt();
     return;
 
   case 'r':
@@ -675,12 +937,17 @@ void GdbServer::rspClientRequest() {
   case 'T':
     // Is the thread alive. We are bare metal, so don't have a thread
     // context. The answer is always "OK".
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
     return;
 
   case 'v':
     // Any one of a number of packets to control execution
-    rspVpkt();
+    rspNamedPkt();
+    return;
+
+  case 'x':
+    // Read memory (binary)
+    rspReadMemBin();
     return;
 
   case 'X':
@@ -706,7 +973,7 @@ void GdbServer::rspClientRequest() {
 
   // If this point is hit, an unsupported packet has been sent, return an empty
   // packet for this case
-  rsp->putPkt("");
+  rsp->putPkt(RspPacket::EMPTY);
 }
 
 //! Send a packet acknowledging an exception has occurred
@@ -715,13 +982,20 @@ void GdbServer::rspClientRequest() {
 
 void GdbServer::rspReportException(TargetSignal sig) {
   // Construct a signal received packet
-  if (mHaveMultiProc)
-    rsp->putPkt(RspPacket::CreateFormatted(
-        "T%02xthread:p%x.1;", (static_cast<int>(sig) & 0xff),
-        CoreManager::coreNum2Pid(cpu->getCurrentCpu())));
-  else
-    rsp->putPkt(
-        RspPacket::CreateFormatted("S%02x", (static_cast<int>(sig) & 0xff)));
+  RspPacketBuilder reply;
+
+  if (mHaveMultiProc) {
+    reply += 'T';
+    reply.addHex(static_cast<int>(sig) & 0xff, 2);
+    reply += "thread:p";
+    reply.addHex(CoreManager::coreNum2Pid(cpu->getCurrentCpu()));
+    reply += ".1;";
+  } else {
+    reply += 'S';
+    reply.addHex(static_cast<int>(sig) & 0xff, 2);
+  }
+
+  rsp->putPkt(reply);
 }
 
 //! Handle a RSP read all registers request
@@ -768,7 +1042,7 @@ void GdbServer::rspWriteAllRegs() {
            << "." << endl;
   }
 
-  rsp->putPkt("OK");
+  rsp->putPkt(RspPacket::OK);
 }
 
 //! Handle a RSP read memory (symbolic) request
@@ -784,15 +1058,16 @@ void GdbServer::rspWriteAllRegs() {
 void GdbServer::rspReadMem() {
   uint_reg_t addr;           // Where to read the memory
   uint_addr_t len;           // Number of bytes to read
-  uint_addr_t off;           // Offset into the memory
   uint8_t *buf;              // Where to read the raw data
   RspPacketBuilder response; // Response to memory request
 
-  if (2 !=
-      sscanf(pkt.getRawData(), "m%" PRIxREG ",%" PRIxADDR ":", &addr, &len)) {
+  PacketParser parser(pkt.getData());
+
+  if (!(parser.expect('m') && parser.hex(addr) && parser.expect(',') &&
+        parser.hex(len))) {
     cerr << "Warning: Failed to recognize RSP read memory command: "
          << pkt.getRawData() << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
@@ -804,11 +1079,8 @@ void GdbServer::rspReadMem() {
   }
 
   buf = new uint8_t[len];
-  if (len == cpu->read(addr, buf, len))
-    for (off = 0; off < len; off++) {
-      response += Utils::hex2Char(buf[off] >> 4);
-      response += Utils::hex2Char(buf[off] & 0xf);
-    }
+  if (len == mMemCache.read(addr, buf, len))
+    Utils::hexEncode(response.addSpace(len * 2), buf, len);
   else
     cerr << "Warning: failed to read " << len << "chars" << endl;
 
@@ -816,6 +1088,50 @@ void GdbServer::rspReadMem() {
   rsp->putPkt(response);
 }
 
+//! Handle a RSP read memory (binary) request
+
+//! Syntax is:
+
+//!   x<addr>,<length>
+
+//! The reply is 'b' followed by the bytes read as raw binary, which are
+//! escaped as the packet is sent, or E01 if the memory can't be read. The
+//! bytes are read straight into the reply, so there is no conversion.
+
+void GdbServer::rspReadMemBin() {
+  uint_addr_t addr; // Where to read the memory
+  std::size_t len;  // Number of bytes to read
+  PacketParser parser(pkt.getData());
+
+  if (!(parser.expect('x') && parser.hex(addr) && parser.expect(',') &&
+        parser.hex(len) && parser.atEnd())) {
+    cerr << "Warning: Failed to recognize RSP read memory command: "
+         << pkt.getRawData() << endl;
+    rsp->putPkt(RspPacket::E01);
+    return;
+  }
+
+  // Make sure we won't overflow the buffer (allowing for the 'b')
+  if (len >= pkt.getMaxPacketSize()) {
+    cerr << "Warning: Memory read " << pkt.getRawData()
+         << " too large for RSP packet: truncated" << endl;
+    len = pkt.getMaxPacketSize() - 1;
+  }
+
+  RspPacketBuilder response;
+  response += 'b';
+  uint8_t *buf = reinterpret_cast<uint8_t *>(response.addSpace(len));
+
+  if (len != mMemCache.read(addr, buf, len)) {
+    cerr << "Warning: failed to read " << len << " bytes from 0x" << hex
+         << addr << dec << endl;
+    rsp->putPkt(RspPacket::E01);
+    return;
+  }
+
+  rsp->putPkt(response);
+}
+
 //! Handle a RSP write memory (symbolic) request
 
 //! Syntax is:
@@ -831,39 +1147,90 @@ void GdbServer::rspWriteMem() {
   uint_addr_t addr; // Where to write the memory
   uint_addr_t len;  // Number of bytes to write
 
-  if (2 !=
-      sscanf(pkt.getRawData(), "M%" PRIxADDR ",%" PRIxADDR ":", &addr, &len)) {
+  PacketParser parser(pkt.getData());
+
+  if (!(parser.expect('M') && parser.hex(addr) && parser.expect(',') &&
+        parser.hex(len) && parser.expect(':'))) {
     cerr << "Warning: Failed to recognize RSP write memory " << pkt.getRawData()
          << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
-  // Find the start of the data and check there is the amount we expect.
-  char *symDat =
-      (char *)(memchr(pkt.getRawData(), ':', pkt.getMaxPacketSize())) + 1;
-  std::size_t datLen = pkt.getLen() - (symDat - pkt.getRawData());
+  // The rest is the data. Check there is the amount we expect.
+  ByteView data = parser.rest();
+  const char *symDat = data.getData();
+  std::size_t datLen = data.getLen();
 
   // Sanity check
   if (len * 2 != datLen) {
     cerr << "Warning: Write of " << len * 2 << "digits requested, but "
          << datLen << " digits supplied: packet ignored" << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
+    return;
+  }
+
+  uint8_t *buf = new uint8_t[len];
+
+  if (!Utils::hexDecode(buf, symDat, len)) {
+    cerr << "Warning: Write data " << symDat
+         << " is not hex digits: packet ignored" << endl;
+    delete[] buf;
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
   // Write the bytes to memory (no check the address is OK here)
-  for (std::size_t off = 0; off < len; off++) {
-    assert(Utils::isHexStr(&symDat[off * 2], 2));
-    uint8_t nyb1 = Utils::char2Hex(symDat[off * 2]);
-    uint8_t nyb2 = Utils::char2Hex(symDat[off * 2 + 1]);
-    uint8_t val = static_cast<unsigned int>((nyb1 << 4) | nyb2);
-
-    if (1 != cpu->write(addr + off, &val, 1))
-      cerr << "Warning: Failed to write character" << endl;
+  rspWriteMemBlock(addr, buf, len);
+  delete[] buf;
+}
+
+//! Write a block of memory for a RSP write memory request, and reply
+
+//! The block is handed to the target in one write. If the target writes
+//! less than asked, we carry on from where it stopped, until it makes no
+//! progress.
+
+//! The reply is "OK" if the whole block was written. Otherwise it is an
+//! error which, if the client accepts textual error messages, says how many
+//! bytes were written.
+
+//! @param[in] addr  Where to write the block
+//! @param[in] buf   The bytes to write
+//! @param[in] len   The number of bytes to write
+
+void GdbServer::rspWriteMemBlock(uint_addr_t addr, const uint8_t *buf,
+                                 std::size_t len) {
+  std::size_t written = 0;
+
+  while (written < len) {
+    std::size_t count =
+        mMemCache.write(addr + written, &buf[written], len - written);
+
+    if ((0 == count) || (count > (len - written)))
+      break;
+
+    written += count;
+  }
+
+  if (written == len) {
+    rsp->putPkt(RspPacket::OK);
+    return;
   }
 
-  rsp->putPkt("OK");
+  cerr << "Warning: Failed to write " << len << " bytes to 0x" << hex << addr
+       << dec << ": only " << written << " bytes written" << endl;
+
+  if (mHaveErrorMessage) {
+    RspPacketBuilder reply;
+    reply += "E.Only ";
+    reply.addDec(written);
+    reply += " of ";
+    reply.addDec(len);
+    reply += " bytes written";
+    rsp->putPkt(reply);
+  } else
+    rsp->putPkt(RspPacket::E01);
 }
 
 //! Read a single register
@@ -875,12 +1242,13 @@ void GdbServer::rspWriteMem() {
 
 void GdbServer::rspReadReg() {
   unsigned int regNum;
+  PacketParser parser(pkt.getData());
 
   // Break out the fields from the data
-  if (1 != sscanf(pkt.getRawData(), "p%x", &regNum)) {
+  if (!(parser.expect('p') && parser.hex(regNum))) {
     cerr << "Warning: Failed to recognize RSP read register command: "
          << pkt.getRawData() << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
@@ -907,29 +1275,29 @@ void GdbServer::rspReadReg() {
 void GdbServer::rspWriteReg() {
   std::size_t regByteSize = cpu->getRegisterSize();
   unsigned int regNum;
-  const int valstr_len = 2 * sizeof(uint_reg_t);
-  char valstr[valstr_len + 1]; // Allow for EOS
+  PacketParser parser(pkt.getData());
+  ByteView valstr;
 
   // Break out the fields from the data
-  std::ostringstream fmt_stream;
-  fmt_stream << "P%x=%" << valstr_len << "s";
-  string fmt = fmt_stream.str();
-  if (2 != sscanf(pkt.getRawData(), fmt.c_str(), &regNum, valstr)) {
+  if (parser.expect('P') && parser.hex(regNum) && parser.expect('='))
+    valstr = parser.rest();
+
+  if ((valstr.getLen() < regByteSize * 2) ||
+      !Utils::isHexStr(valstr.getData(), regByteSize * 2)) {
     cerr << "Warning: Failed to recognize RSP write register command "
          << pkt.getRawData() << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
-  valstr[valstr_len] = '\0';
 
-  uint_reg_t val =
-      Utils::hex2RegVal(valstr, regByteSize, true /* little endian */);
+  uint_reg_t val = Utils::hex2RegVal(valstr.getData(), regByteSize,
+                                     true /* little endian */);
 
   if (regByteSize != cpu->writeRegister(regNum, val))
     cerr << "Warning: Size != " << regByteSize << " when writing reg " << regNum
          << "." << endl;
 
-  rsp->putPkt("OK");
+  rsp->putPkt(RspPacket::OK);
 }
 
 //! Send out a single thread info reply packet
@@ -948,7 +1316,8 @@ void GdbServer::rspWriteNextThreadInfo() {
     coreNum = CoreManager::pid2CoreNum(mNextProcess);
     mNextProcess++;
   } while (coreNum < mCoreManager.getCpuCount() &&
-           (mKillCoreOnExit && !mCoreManager.isCoreLive(coreNum)));
+           (!mCoreManager.isCoreOwned(coreNum) ||
+            (mKillCoreOnExit && !mCoreManager.isCoreLive(coreNum))));
 
   if (coreNum < mCoreManager.getCpuCount()) {
     char ptid_str[32];
@@ -960,139 +1329,219 @@ void GdbServer::rspWriteNextThreadInfo() {
       response += ptid_str;
       rsp->putPkt(response);
     } else
-      rsp->putPkt("E01");
+      rsp->putPkt(RspPacket::E01);
   } else
     rsp->putPkt("l"); // All done
 }
 
-//! Handle a RSP query request
+//! Table of the packets identified by name
+
+//! Built once, and shared by all sessions. Any 'q', 'Q' or 'v' packet not
+//! found here is not supported. This makes us flexible to future GDB
+//! releases with as yet undefined packets.
+
+//! @return  The table
+
+const PacketTable<GdbServer::PktHandler> &GdbServer::namedPackets() {
+  static const PacketTable<PktHandler> table = [] {
+    PacketTable<PktHandler> t;
+
+    // Queries
+    t.addExact("qC", &GdbServer::rspQueryCurrentThread);
+    t.addExact("qfThreadInfo", &GdbServer::rspQueryFirstThreadInfo);
+    t.addExact("qsThreadInfo", &GdbServer::rspWriteNextThreadInfo);
+    t.addPrefix("qL", &GdbServer::rspQueryThreadList);
+    t.addPrefix("qRcmd,", &GdbServer::rspCommand);
+    t.addPrefix("qSupported", &GdbServer::rspQuerySupported);
+    t.addPrefix("qSymbol:", &GdbServer::rspQuerySymbol);
+    t.addPrefix("qThreadExtraInfo,", &GdbServer::rspQueryThreadExtraInfo);
+    t.addPrefix("qXfer:features:read:", &GdbServer::rspQueryFeatures);
+
+    // Sets
+    t.addPrefix("QNonStop:", &GdbServer::rspSetNonStop);
+    t.addExact("QStartNoAckMode", &GdbServer::rspStartNoAckMode);
+
+    // Execution control
+    t.addExact("vCont?", &GdbServer::rspVContQuery);
+    t.addPrefix("vCont", &GdbServer::rspVCont);
+    t.addPrefix("vKill;", &GdbServer::rspVKill);
+
+    return t;
+  }();
+
+  return table;
+}
+
+//! Handle a RSP packet identified by name
 
 //! We deal with those we have an explicit response for and send a null
-//! response to anything else, to indicate it is not supported. This makes us
-//! flexible to future GDB releases with as yet undefined packets.
+//! response to anything else, to indicate it is not supported.
 
-void GdbServer::rspQuery() {
-  if (pkt.getData() == "qC") {
-    // Return the current thread ID (unsigned hex). A null response
-    // indicates to use the previously selected thread.
+void GdbServer::rspNamedPkt() {
+  PktHandler handler = namedPackets().lookup(pkt.getData());
 
-    RspPacketBuilder response;
-    response += "QC";
-    char ptid_str[32];
+  if (handler != nullptr)
+    (this->*handler)();
+  else
+    rsp->putPkt(RspPacket::EMPTY);
+}
 
-    if (mPtid.encode(ptid_str)) {
-      response += ptid_str;
-      rsp->putPkt(response);
-    } else
-      rsp->putPkt("E01");
-  } else if (pkt.getData() == "qfThreadInfo") {
-    // Send information about the first process.  After we send this
-    // reply GDB will send additional 'qsThreadInfo' packets to get
-    // information about all the other threads on the system.
-    //
-    // Our model of the system has one thread per process, and one
-    // process per core.  The cores are number 0 -> X, while processes
-    // are numbered 1 -> (X + 1).
-    mNextProcess = 1;
-    rspWriteNextThreadInfo();
-  } else if (pkt.getData() == "qsThreadInfo") {
-    // Send information about the "next" thread continuing from wherever
-    // the last thread info request left off.
-    rspWriteNextThreadInfo();
-  } else if (pkt.getData().starts_with("qL")) {
-    // Deprecated and replaced by 'qfThreadInfo'
-    cerr << "Warning: RSP qL deprecated: no info returned" << endl;
-    rsp->putPkt("qM001");
-  } else if (pkt.getData().starts_with("qRcmd,")) {
-    // This is used to interface to commands to do "stuff"
-    rspCommand();
-  } else if (pkt.getData().starts_with("qSupported")) {
-    // Report a list of the features we support. For now we just ignore any
-    // supplied specific feature queries, but in the future these may be
-    // supported as well. Note that the packet size allows for 'G' + all the
-    // registers sent to us, or a reply to 'g' with all the registers and an
-    // EOS so the buffer is a well formed string.
-
-    vector<string> tokens;
-    Utils::split(&(pkt.getRawData()[strlen("qSupported:")]), ";", tokens);
-    const char *multiProcStr = "";
-    const char *supportsTargetXML = "";
-
-    if (cpu->supportsTargetXML())
-      supportsTargetXML = ";qXfer:features:read+";
-
-    // We can only support multiprocess and XML target descriptions if the
-    // client says it supports it. Offering eitther when it is not there
-    // causes some really weird behavior!
-
-    mHaveMultiProc = false;
-
-    for (auto it = tokens.begin(); it != tokens.end(); it++) {
-      if (*it == "multiprocess+") {
+//! Handle a RSP qC request
+
+//! Return the current thread ID (unsigned hex). A null response indicates
+//! to use the previously selected thread.
+
+void GdbServer::rspQueryCurrentThread() {
+  RspPacketBuilder response;
+  response += "QC";
+  char ptid_str[32];
+
+  if (mPtid.encode(ptid_str)) {
+    response += ptid_str;
+    rsp->putPkt(response);
+  } else
+    rsp->putPkt(RspPacket::E01);
+}
+
+//! Handle a RSP qfThreadInfo request
+
+//! Send information about the first process.  After we send this reply GDB
+//! will send additional 'qsThreadInfo' packets to get information about all
+//! the other threads on the system.
+
+//! Our model of the system has one thread per process, and one process per
+//! core.  The cores are number 0 -> X, while processes are numbered 1 -> (X
+//! + 1).
+
+void GdbServer::rspQueryFirstThreadInfo() {
+  mNextProcess = 1;
+  rspWriteNextThreadInfo();
+}
+
+//! Handle a RSP qL request
+
+//! Deprecated and replaced by 'qfThreadInfo'
+
+void GdbServer::rspQueryThreadList() {
+  cerr << "Warning: RSP qL deprecated: no info returned" << endl;
+  rsp->putPkt("qM001");
+}
+
+//! Handle a RSP qSupported request
+
+//! Report a list of the features we support. For now we just ignore any
+//! supplied specific feature queries, but in the future these may be
+//! supported as well. Note that the packet size allows for 'G' + all the
+//! registers sent to us, or a reply to 'g' with all the registers and an EOS
+//! so the buffer is a well formed string.
+
+void GdbServer::rspQuerySupported() {
+  PacketParser parser(pkt.getData());
+  const char *multiProcStr = "";
+  const char *supportsTargetXML = "";
+  const char *noAckStr = "";
+
+  if (cpu->supportsTargetXML())
+    supportsTargetXML = ";qXfer:features:read+";
+
+  // We can only support multiprocess and XML target descriptions if the
+  // client says it supports it. Offering eitther when it is not there
+  // causes some really weird behavior!
+
+  // Acknowledgements are only worth having if the connection can corrupt
+  // or lose characters. GDB turns them off as soon as we offer this.
+
+  if (rsp->isReliable())
+    noAckStr = ";QStartNoAckMode+";
+
+  mHaveMultiProc = false;
+  mHaveErrorMessage = false;
+
+  if (parser.expect("qSupported:"))
+    do {
+      ByteView feature = parser.field(';');
+
+      if (feature == "multiprocess+") {
         mHaveMultiProc = true;
         multiProcStr = ";multiprocess+";
-      }
-    }
+      } else if (feature == "error-message+")
+        mHaveErrorMessage = true;
+    } while (parser.expect(';'));
+
+  RspPacketBuilder reply;
+  reply += "PacketSize=";
+  reply.addHex(pkt.getMaxPacketSize());
+  reply += ";QNonStop+;VContSupported+;binary-upload+";
+  reply += noAckStr;
+  reply += supportsTargetXML;
+  reply += multiProcStr;
+  rsp->putPkt(reply);
+}
 
-    rsp->putPkt(RspPacket::CreateFormatted(
-        "PacketSize=%" PRIxPTR
-        ";QNonStop+;VContSupported+;QStartNoAckMode+%s%s",
-        pkt.getMaxPacketSize(), supportsTargetXML, multiProcStr));
-
-  } else if (pkt.getData().starts_with("qSymbol:")) {
-    // Offer to look up symbols. Nothing we want (for now). TODO. This just
-    // ignores any replies to symbols we looked up, but we didn't want to
-    // do that anyway!
-    rsp->putPkt("OK");
-  } else if (pkt.getData().starts_with("qThreadExtraInfo,")) {
-    // Report that we are runnable, but the text must be hex ASCI
-    // digits. Send "Runnable"
-    rsp->putPkt("52756e6e61626c65");
-  } else if (pkt.getData().starts_with("qXfer:features:read:")) {
-    // Extract XML file name and offsets
-    std::vector<ByteView> operands;
-    Utils::split(pkt.getData(), ':', operands);
-    if (operands.size() != 5) {
-      rsp->putPkt("E00");
-      return;
-    }
-    std::vector<ByteView> offsets;
-    Utils::split(operands[4], ',', offsets);
-    if (offsets.size() != 2) {
-      rsp->putPkt("E00");
-      return;
-    }
-    uint64_t start, len;
-    if (!offsets[0].fromHex(start)) {
-      rsp->putPkt("E00");
-      return;
-    }
-    if (!offsets[1].fromHex(len)) {
-      rsp->putPkt("E00");
-      return;
-    }
+//! Handle a RSP qSymbol request
 
-    // Get file, pack and send
-    const char *file = cpu->getTargetXML(operands[3]);
-    if (!file) {
-      rsp->putPkt("E00");
-      return;
-    }
-    ByteView fileView = ByteView(file).lstrip(static_cast<std::size_t>(start));
+//! Offer to look up symbols. Nothing we want (for now). TODO. This just
+//! ignores any replies to symbols we looked up, but we didn't want to do
+//! that anyway!
 
-    // If this is the last snippet, respond with 'l', else 'm'
-    RspPacketBuilder response;
-    if (fileView.getLen() <= len)
-      response += 'l';
-    else
-      response += 'm';
-    response.addData(fileView.first(static_cast<std::size_t>(len)));
-    rsp->putPkt(response);
+void GdbServer::rspQuerySymbol() { rsp->putPkt(RspPacket::OK); }
+
+//! Handle a RSP qThreadExtraInfo request
+
+//! Report that we are runnable, but the text must be hex ASCI digits. Send
+//! "Runnable"
+
+void GdbServer::rspQueryThreadExtraInfo() { rsp->putPkt("52756e6e61626c65"); }
+
+//! Handle a RSP qXfer:features:read request
+
+void GdbServer::rspQueryFeatures() {
+  // Extract XML file name and offsets
+  PacketParser parser(pkt.getData());
+  ByteView annex;
+  uint64_t start, len;
+
+  if (parser.expect("qXfer:features:read:"))
+    annex = parser.field(':');
+
+  if (!(parser.expect(':') && parser.hex(start) && parser.expect(',') &&
+        parser.hex(len) && parser.atEnd())) {
+    rsp->putPkt(RspPacket::E00);
+    return;
+  }
+
+  // Get file, pack and send
+  const char *file = cpu->getTargetXML(annex);
+  if (!file) {
+    rsp->putPkt(RspPacket::E00);
     return;
-  } else {
-    // We don't support this feature
-    rsp->putPkt("");
   }
+  ByteView fileView = ByteView(file).lstrip(static_cast<std::size_t>(start));
+
+  // If this is the last snippet, respond with 'l', else 'm'
+  RspPacketBuilder response;
+  if (fileView.getLen() <= len)
+    response += 'l';
+  else
+    response += 'm';
+  response.addData(fileView.first(static_cast<std::size_t>(len)));
+  rsp->putPkt(response);
+}
+
+//! Parse a monitor command which sets a timeout
+
+//! @param[in]  cmd      The command
+//! @param[in]  name     The name of the timeout
+//! @param[out] timeout  The timeout given, in hex, if the command sets it
+//! @return  TRUE if the command is the name, a space and the timeout, FALSE
+//!          otherwise.
+
+static bool parseTimeout(const char *cmd, const char *name,
+                         uint64_t &timeout) {
+  PacketParser parser(cmd);
+
+  return parser.expect(name) && parser.expect(' ') && parser.hex(timeout) &&
+         parser.atEnd();
 }
 
 //! Handle a RSP qRcmd request
@@ -1100,7 +1549,7 @@ void GdbServer::rspQuery() {
 //! The actual command follows the "qRcmd," in ASCII encoded to hex
 
 void GdbServer::rspCommand() {
-  char *cmd = new char[pkt.getMaxPacketSize() / 2];
+  char *cmd = new char[pkt.getLen() / 2 + 1];
   uint64_t timeout;
 
   Utils::hex2Ascii(cmd, &(pkt.getRawData()[strlen("qRcmd,")]));
@@ -1109,6 +1558,9 @@ void GdbServer::rspCommand() {
     cout << "RSP trace: qRcmd," << cmd << endl;
   }
 
+  // Target specific commands may change memory behind our back.
+  mMemCache.flush();
+
   if (0 == strncmp("help", cmd, strlen(cmd))) {
     static const char *mess[] = {
         "The following generic monitor commands are supported:\n",
@@ -1132,6 +1584,12 @@ void GdbServer::rspCommand() {
         "    Set debug flag in target and optional associated value\n",
         "  show debug [<flag>]\n",
         "    Show debug for one flag or all flags in target\n",
+        "  set keep-state [on|off|0|1]\n",
+        "    Keep the state of the cores when GDB reconnects\n",
+        "  set mem-cache <line size>|off\n",
+        "    Cache target memory while the cores are halted\n",
+        "  set prefetch <pc reg> <pc bytes> <sp reg> <sp bytes>\n",
+        "    Fetch memory around the PC and SP when a core stops\n",
         "  echo <message>\n",
         "    Echo <message> on stdout of the gdbserver\n",
         nullptr};
@@ -1162,84 +1620,102 @@ void GdbServer::rspCommand() {
 
     // Not silent, so acknowledge OK
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if ((0 == strcmp(cmd, "reset")) || (0 == strcmp(cmd, "reset warm"))) {
     // First, bring all the cores back to life.
     mCoreManager.reset();
+    mMemCache.flush();
 
     // Warm reset the CPU.  Failure to reset causes us to blow up.
 
     if (ITarget::ResumeRes::SUCCESS != cpu->reset(ITarget::ResetType::WARM))
       Utils::fatalError("Failed to reset");
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "reset cold")) {
     // First, bring all the cores back to life.
     mCoreManager.reset();
+    mMemCache.flush();
 
     // Cold reset the CPU.  Failure to reset causes us to blow up.
 
     if (ITarget::ResumeRes::SUCCESS != cpu->reset(ITarget::ResetType::COLD))
       Utils::fatalError("Failed to cold reset");
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "exit")) {
     mExitServer = true;
-  } else if ((1 == sscanf(cmd, "timeout %" PRIx64, &timeout)) ||
-             (1 == sscanf(cmd, "real-timeout %" PRIx64, &timeout))) {
+  } else if (parseTimeout(cmd, "timeout", timeout) ||
+             parseTimeout(cmd, "real-timeout", timeout)) {
     mTimeout.realTimeout(
         std::chrono::duration<double>(static_cast<double>(timeout)));
-    rsp->putPkt("OK");
-  } else if (1 == sscanf(cmd, "cycle-timeout %" PRIx64, &timeout)) {
+    rsp->putPkt(RspPacket::OK);
+  } else if (parseTimeout(cmd, "cycle-timeout", timeout)) {
     mTimeout.cycleTimeout(timeout);
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "real-timestamp")) {
     // @todo Do this using std::put_time, which is not in pre 5.0 GCC. Not
     // thread safe.
 
-    std::ostringstream oss;
     time_t now_c = system_clock::to_time_t(system_clock::now());
     struct tm *timeinfo = std::localtime(&(now_c));
     char buff[20];
 
     strftime(buff, 20, "%F %T", timeinfo);
-    oss << buff << endl;
-    rsp->putPkt(RspPacket::CreateHexStr(oss.str().c_str()));
+    RspPacketBuilder text;
+    text += buff;
+    text += '\n';
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(text.getData());
+    rsp->putPkt(reply);
 
     // Not silent, so acknowledge OK
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "timestamp")) {
-    std::ostringstream oss;
-    oss << cpu->timeStamp() << endl;
-    rsp->putPkt(RspPacket::CreateHexStr(oss.str().c_str()));
+    // Formatted as a stream would, with six significant digits
+    char buff[32];
+    snprintf(buff, sizeof(buff), "%g\n", cpu->timeStamp());
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(buff);
+    rsp->putPkt(reply);
 
     // Not silent, so acknowledge OK
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "cyclecount")) {
-    std::ostringstream oss;
-    oss << cpu->getCycleCount() << endl;
-    rsp->putPkt(RspPacket::CreateHexStr(oss.str().c_str()));
+    RspPacketBuilder text;
+    text.addDec(cpu->getCycleCount());
+    text += '\n';
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(text.getData());
+    rsp->putPkt(reply);
 
     // Not silent, so acknowledge OK
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strcmp(cmd, "instrcount")) {
-    std::ostringstream oss;
-    oss << cpu->getInstrCount() << endl;
-    rsp->putPkt(RspPacket::CreateHexStr(oss.str().c_str()));
+    RspPacketBuilder text;
+    text.addDec(cpu->getInstrCount());
+    text += '\n';
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(text.getData());
+    rsp->putPkt(reply);
 
     // Not silent, so acknowledge OK
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (0 == strncmp(cmd, "echo", 4)) {
     const char *tmp = cmd + 4;
     while (*tmp != '\0' && isspace(*tmp))
       ++tmp;
     cerr << std::flush;
     cout << tmp << std::endl << std::flush;
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   }
   // Insert any new generic commands here.
   // Don't forget to document them.
@@ -1268,17 +1744,58 @@ void GdbServer::rspCommand() {
 
       // Not silent, so acknowledge OK
 
-      rsp->putPkt("OK");
+      rsp->putPkt(RspPacket::OK);
     } else {
       // Command failed
 
-      rsp->putPkt("E01");
+      rsp->putPkt(RspPacket::E01);
     }
   }
 
   delete[] cmd;
 }
 
+//! Parse the state given for an on/off setting
+
+//! @param[in]  str    The state: 1|0|on|off|true|false, in any case
+//! @param[out] state  The state given, if it is valid
+//! @return  TRUE if the state is valid, FALSE otherwise.
+
+static bool parseOnOff(const string &str, bool &state) {
+  if ((0 == strcasecmp(str.c_str(), "0")) ||
+      (0 == strcasecmp(str.c_str(), "off")) ||
+      (0 == strcasecmp(str.c_str(), "false")))
+    state = false;
+  else if ((0 == strcasecmp(str.c_str(), "1")) ||
+           (0 == strcasecmp(str.c_str(), "on")) ||
+           (0 == strcasecmp(str.c_str(), "true")))
+    state = true;
+  else
+    return false;
+
+  return true;
+}
+
+//! Handle a RSP qRcmd request for set of an on/off setting
+
+//! With no state given, the setting is turned on.
+
+//! @param[out] setting  The setting to change
+//! @param[in]  tokens   The command, starting with the name of the setting
+
+void GdbServer::rspSetOnOff(bool &setting, const vector<string> &tokens) {
+  bool state = true;
+
+  if ((tokens.size() > 1) && !parseOnOff(tokens[1], state)) {
+    // Not a valid level
+    rsp->putPkt(RspPacket::E02);
+    return;
+  }
+
+  setting = state;
+  rsp->putPkt(RspPacket::OK);
+}
+
 //! Handle a RSP qRcmd request for set
 
 //! The main rspCommand function has decoded the argument string and
@@ -1308,7 +1825,7 @@ void GdbServer::rspSetCommand(const char *cmd) {
     if (!traceFlags->isFlag(flagName)) {
       // Not a valid flag
 
-      rsp->putPkt("E01");
+      rsp->putPkt(RspPacket::E01);
       return;
     }
 
@@ -1319,18 +1836,10 @@ void GdbServer::rspSetCommand(const char *cmd) {
     else {
       // Valid state?
 
-      if ((0 == strcasecmp(tokens[2].c_str(), "0")) ||
-          (0 == strcasecmp(tokens[2].c_str(), "off")) ||
-          (0 == strcasecmp(tokens[2].c_str(), "false")))
-        flagState = false;
-      else if ((0 == strcasecmp(tokens[2].c_str(), "1")) ||
-               (0 == strcasecmp(tokens[2].c_str(), "on")) ||
-               (0 == strcasecmp(tokens[2].c_str(), "true")))
-        flagState = true;
-      else {
+      if (!parseOnOff(tokens[2], flagState)) {
         // Not a valid level
 
-        rsp->putPkt("E02");
+        rsp->putPkt(RspPacket::E02);
         return;
       }
     }
@@ -1343,30 +1852,63 @@ void GdbServer::rspSetCommand(const char *cmd) {
     else
       traceFlags->flagState(flagName, flagState);
 
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
     return;
   } else if (string("kill-core-on-exit") == tokens[0]) {
-    // Valid state?
+    rspSetOnOff(mKillCoreOnExit, tokens);
+    return;
+  } else if (string("keep-state") == tokens[0]) {
+    rspSetOnOff(mKeepState, tokens);
+    return;
+  } else if ((numTok == 2) && (string("mem-cache") == tokens[0])) {
+    // monitor set mem-cache <line size>|off
 
-    if (numTok == 1) {
-      mKillCoreOnExit = true;
-    } else {
-      if ((0 == strcasecmp(tokens[1].c_str(), "0")) ||
-          (0 == strcasecmp(tokens[1].c_str(), "off")) ||
-          (0 == strcasecmp(tokens[1].c_str(), "false")))
-        mKillCoreOnExit = false;
-      else if ((0 == strcasecmp(tokens[1].c_str(), "1")) ||
-               (0 == strcasecmp(tokens[1].c_str(), "on")) ||
-               (0 == strcasecmp(tokens[1].c_str(), "true")))
-        mKillCoreOnExit = true;
-      else {
-        // Not a valid level
-        rsp->putPkt("E02");
+    std::size_t lineSize = 0;
+
+    if (0 != strcasecmp(tokens[1].c_str(), "off")) {
+      char *end;
+      lineSize = strtoul(tokens[1].c_str(), &end, 0);
+
+      if ((*end != '\0') || (lineSize == 0)) {
+        rsp->putPkt(RspPacket::E02);
         return;
       }
     }
 
-    rsp->putPkt("OK");
+    // The line size must be a power of two
+    if (!mMemCache.setLineSize(lineSize)) {
+      rsp->putPkt(RspPacket::E02);
+      return;
+    }
+
+    rsp->putPkt(RspPacket::OK);
+    return;
+  } else if ((numTok == 5) && (string("prefetch") == tokens[0])) {
+    // monitor set prefetch <pc reg> <pc bytes> <sp reg> <sp bytes>
+
+    char *pcRegEnd;
+    char *pcEnd;
+    char *spRegEnd;
+    char *spEnd;
+    long pcRegnum = strtol(tokens[1].c_str(), &pcRegEnd, 0);
+    std::size_t pcBytes = strtoul(tokens[2].c_str(), &pcEnd, 0);
+    long spRegnum = strtol(tokens[3].c_str(), &spRegEnd, 0);
+    std::size_t spBytes = strtoul(tokens[4].c_str(), &spEnd, 0);
+
+    if ((*pcRegEnd != '\0') || (*pcEnd != '\0') || (*spRegEnd != '\0') ||
+        (*spEnd != '\0') || (pcRegnum > INT_MAX) || (spRegnum > INT_MAX)) {
+      rsp->putPkt(RspPacket::E02);
+      return;
+    }
+
+    // Registers which don't exist are refused
+    if (!setStopPrefetch(static_cast<int>(pcRegnum), pcBytes,
+                         static_cast<int>(spRegnum), spBytes)) {
+      rsp->putPkt(RspPacket::E02);
+      return;
+    }
+
+    rsp->putPkt(RspPacket::OK);
     return;
   } else {
     // Not handled here, try the target
@@ -1379,11 +1921,11 @@ void GdbServer::rspSetCommand(const char *cmd) {
 
       // Not silent, so acknowledge OK
 
-      rsp->putPkt("OK");
+      rsp->putPkt(RspPacket::OK);
     } else {
       // Command failed
 
-      rsp->putPkt("E04");
+      rsp->putPkt(RspPacket::E04);
     }
   }
 }
@@ -1406,7 +1948,7 @@ void GdbServer::rspShowCommand(const char *cmd) {
     // monitor show debug
 
     rsp->putPkt(RspPacket::CreateRcmdStr(traceFlags->dump().c_str(), true));
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if ((numTok == 2) && (string("debug") == tokens[0])) {
     // monitor show debug <flag>
 
@@ -1418,7 +1960,7 @@ void GdbServer::rspShowCommand(const char *cmd) {
     if (!traceFlags->isFlag(flagName)) {
       // Not a valid flag
 
-      rsp->putPkt("E01");
+      rsp->putPkt(RspPacket::E01);
       return;
     }
 
@@ -1430,15 +1972,65 @@ void GdbServer::rspShowCommand(const char *cmd) {
     oss << endl;
 
     rsp->putPkt(RspPacket::CreateRcmdStr(oss.str().c_str(), true));
-    rsp->putPkt("OK");
+    rsp->putPkt(RspPacket::OK);
   } else if (string("kill-core-on-exit") == tokens[0]) {
 
-    ostringstream oss;
-    oss << "kill-core-on-exit: " << (mKillCoreOnExit ? "ON" : "OFF");
-    oss << endl;
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(mKillCoreOnExit ? "kill-core-on-exit: ON\n"
+                                    : "kill-core-on-exit: OFF\n");
+    rsp->putPkt(reply);
+    rsp->putPkt(RspPacket::OK);
+  } else if (string("keep-state") == tokens[0]) {
+
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(mKeepState ? "keep-state: ON\n" : "keep-state: OFF\n");
+    rsp->putPkt(reply);
+    rsp->putPkt(RspPacket::OK);
+  } else if (string("mem-cache") == tokens[0]) {
+
+    RspPacketBuilder text;
+    text += "mem-cache: ";
+
+    if (mMemCache.getLineSize() == 0)
+      text += "OFF";
+    else {
+      text.addDec(mMemCache.getLineSize());
+      text += " byte lines";
+    }
 
-    rsp->putPkt(RspPacket::CreateRcmdStr(oss.str().c_str(), true));
-    rsp->putPkt("OK");
+    text += '\n';
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(text.getData());
+    rsp->putPkt(reply);
+    rsp->putPkt(RspPacket::OK);
+  } else if (string("prefetch") == tokens[0]) {
+
+    RspPacketBuilder text;
+    text += "prefetch: ";
+    text.addDec(mPrefetchPc);
+    text += " bytes around PC";
+    if (mPrefetchPc != 0) {
+      text += " (register ";
+      text.addDec(mPcRegnum);
+      text += ")";
+    }
+    text += ", ";
+    text.addDec(mPrefetchSp);
+    text += " bytes above SP";
+    if (mPrefetchSp != 0) {
+      text += " (register ";
+      text.addDec(mSpRegnum);
+      text += ")";
+    }
+    text += "\n";
+    RspPacketBuilder reply;
+    reply += 'O';
+    reply.addHexStr(text.getData());
+    rsp->putPkt(reply);
+    rsp->putPkt(RspPacket::OK);
   } else {
     // Not handled here, try the target
 
@@ -1450,43 +2042,52 @@ void GdbServer::rspShowCommand(const char *cmd) {
 
       // Not silent, so acknowledge OK
 
-      rsp->putPkt("OK");
+      rsp->putPkt(RspPacket::OK);
     } else {
       // Command failed
 
-      rsp->putPkt("E04");
+      rsp->putPkt(RspPacket::E04);
     }
   }
 }
 
-//! Handle a RSP set request.
+//! Handle a RSP QNonStop request
 
-void GdbServer::rspSet() {
-  if (pkt.getData().starts_with("QNonStop:")) {
-    switch (pkt.getData()[strlen("QNonStop:")]) {
-    case '0':
-      mStopMode = StopMode::ALL_STOP;
-      break;
-    case '1':
-      mStopMode = StopMode::NON_STOP;
-      break;
+void GdbServer::rspSetNonStop() {
+  PacketParser parser(pkt.getData());
+  ByteView mode;
 
-    default:
-      rsp->putPkt("E01");
-      return;
-    }
+  if (parser.expect("QNonStop:"))
+    mode = parser.rest();
 
-    rsp->putPkt("OK");
-    return;
-  } else if (pkt.getData() == "QStartNoAckMode") {
-    rsp->setNoAckMode(true);
-    rsp->putPkt("OK");
+  if (mode == "0")
+    mStopMode = StopMode::ALL_STOP;
+  else if (mode == "1")
+    mStopMode = StopMode::NON_STOP;
+  else {
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
-  rsp->putPkt("");
+  rsp->putPkt(RspPacket::OK);
+}
+
+//! Handle a RSP QStartNoAckMode request
+
+void GdbServer::rspStartNoAckMode() {
+  rsp->setNoAckMode(true);
+  rsp->putPkt(RspPacket::OK);
 }
 
+//! Handle a RSP vCont? request
+
+//! What actions are supported in vCont?  If we don't support 'c' and 'C'
+//! then GDB will refuse to use vCont.  If we're going to claim 'C' then we
+//! may as well claim 'S' too.  I don't claim 't' yet, though we probably
+//! will want that in time.
+
+void GdbServer::rspVContQuery() { rsp->putPkt("vCont;c;C;s;S"); }
+
 //! Handle a 'vCont:' packet.  The actual list of things to do is after the
 //! 'vCont:' in the packet buffer.
 //
@@ -1495,9 +2096,9 @@ void GdbServer::rspSet() {
 
 void GdbServer::rspVCont() {
   vector<ITarget::ResumeType> coreActions;
-  VContActions actions(pkt.getRawData());
+  VContActions actions(pkt.getData());
   if (!actions.valid()) {
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
@@ -1505,6 +2106,10 @@ void GdbServer::rspVCont() {
     ITarget::ResumeType resType;
     char action = actions.getCoreAction(CoreManager::coreNum2Pid(i));
 
+    // Cores belonging to other sessions are left alone.
+    if (!mCoreManager.isCoreOwned(i))
+      action = '\0';
+
     switch (action) {
     case '\0':
       resType = ITarget::ResumeType::NONE;
@@ -1521,7 +2126,7 @@ void GdbServer::rspVCont() {
       break;
 
     default:
-      rsp->putPkt("E01");
+      rsp->putPkt(RspPacket::E01);
       return;
     }
 
@@ -1556,23 +2161,20 @@ void GdbServer::rspVCont() {
 //! support is available.
 
 void GdbServer::rspVKill() {
-  Ptid ptid(PID_DEFAULT, TID_DEFAULT);
   unsigned int pid;
-  const char *str = &(pkt.getRawData()[strlen("vKill;")]);
+  PacketParser parser(pkt.getData());
 
-  if (!Utils::isHexStr(str, strlen(str))) {
-    rsp->putPkt("E01");
+  if (!(parser.expect("vKill;") && parser.hex(pid) && parser.atEnd())) {
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
-  pid = (int)(Utils::hex2Val(str, strlen(str)));
-
   if (!mCoreManager.killCoreNum(CoreManager::pid2CoreNum(pid))) {
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
-  rsp->putPkt("OK");
+  rsp->putPkt(RspPacket::OK);
 
   if (mCoreManager.getLiveCoreCount() == 0) {
     rsp->rspClose();
@@ -1581,29 +2183,6 @@ void GdbServer::rspVKill() {
   }
 }
 
-//! Handle a RSP 'v' packet
-
-//! @todo for now we don't handle V packets.
-
-void GdbServer::rspVpkt() {
-  if (pkt.getData() == "vCont?") {
-    // What actions are supported in vCont?  If we don't support 'c' and
-    // 'C' then GDB will refuse to use vCont.  If we're going to claim
-    // 'C' then we may as well claim 'S' too.  I don't claim 't' yet,
-    // though we probably will want that in time.
-    rsp->putPkt("vCont;c;C;s;S");
-  } else if (pkt.getData().starts_with("vCont")) {
-    rspVCont();
-    return;
-  } else if (pkt.getData().starts_with("vKill;")) {
-    rspVKill();
-    return;
-  } else {
-    // Unsupported packet.
-    rsp->putPkt("");
-  }
-}
-
 //! Handle a RSP write memory (binary) request
 
 //! Syntax is:
@@ -1617,22 +2196,22 @@ void GdbServer::rspVpkt() {
 //! already been unescaped, so will hold this number of bytes.
 
 void GdbServer::rspWriteMemBin() {
-  uint32_t addr;   // Where to write the memory
-  std::size_t len; // Number of bytes to write
+  uint_addr_t addr; // Where to write the memory
+  std::size_t len;  // Number of bytes to write
+  PacketParser parser(pkt.getData());
 
-  if (2 !=
-      sscanf(pkt.getRawData(), "X%" PRIx32 ",%" PRIxPTR ":", &addr, &len)) {
+  if (!(parser.expect('X') && parser.hex(addr) && parser.expect(',') &&
+        parser.hex(len) && parser.expect(':'))) {
     cerr << "Warning: Failed to recognize RSP write memory command: "
          << pkt.getRawData() << endl;
-    rsp->putPkt("E01");
+    rsp->putPkt(RspPacket::E01);
     return;
   }
 
-  // Find the start of the data and "unescape" it.
-  uint8_t *bindat =
-      (uint8_t *)(memchr(pkt.getRawData(), ':', pkt.getMaxPacketSize())) + 1;
-  std::size_t off = (char *)bindat - pkt.getRawData();
-  std::size_t newLen = Utils::rspUnescape((char *)bindat, pkt.getLen() - off);
+  // The rest is the data. "Unescape" it in place.
+  ByteView data = parser.rest();
+  uint8_t *bindat = (uint8_t *)data.getData();
+  std::size_t newLen = Utils::rspUnescape((char *)bindat, data.getLen());
 
   // Sanity check
   if (newLen != len) {
@@ -1644,11 +2223,7 @@ void GdbServer::rspWriteMemBin() {
   }
 
   // Write the bytes to memory.
-  if (len != cpu->write(addr, bindat, len))
-    cerr << "Warning: Failed to write " << len << " bytes to 0x" << hex << addr
-         << dec << endl;
-
-  rsp->putPkt("OK");
+  rspWriteMemBlock(addr, bindat, len);
 }
 
 //! Handle a RSP remove breakpoint or matchpoint request
@@ -1659,7 +2234,7 @@ void GdbServer::rspWriteMemBin() {
 //! @todo This doesn't work with icache/immu yet
 
 void GdbServer::rspRemoveMatchpoint() {
-  rsp->putPkt("");
+  rsp->putPkt(RspPacket::EMPTY);
   return;
 }
 
@@ -1668,7 +2243,7 @@ void GdbServer::rspRemoveMatchpoint() {
 //! @todo For now only memory breakpoints are handled
 
 void GdbServer::rspInsertMatchpoint() {
-  rsp->putPkt("");
+  rsp->putPkt(RspPacket::EMPTY);
   return;
 }
 
@@ -1769,10 +2344,26 @@ std::ostream &operator<<(std::ostream &s, GdbServer::MatchpointType p) {
 
 //! Constructor for CoreManager class
 //
-//! Setup data structures to track 'count' cores.
+//! Setup data structures to track 'count' cores, of which this session owns
+//! those listed in 'cores' (or all of them, if 'cores' is empty).
+
+GdbServer::CoreManager::CoreManager(unsigned int count,
+                                    const std::vector<unsigned int> &cores)
+    : mNumCores(count), mNumOwnedCores(0), mFirstCore(count),
+      mOwnedCores(count, cores.empty()) {
+  for (auto coreNum : cores) {
+    assert(coreNum < count);
+    mOwnedCores[coreNum] = true;
+  }
 
-GdbServer::CoreManager::CoreManager(unsigned int count)
-    : mNumCores(count), mLiveCores(count) {
+  for (unsigned int i = 0; i < count; ++i) {
+    if (mOwnedCores[i]) {
+      mNumOwnedCores++;
+      mFirstCore = std::min(mFirstCore, i);
+    }
+  }
+
+  mLiveCores = mNumOwnedCores;
   mCoreStates.resize(count);
 }
 
@@ -1782,7 +2373,7 @@ GdbServer::CoreManager::CoreManager(unsigned int count)
 //! the reset method.
 
 void GdbServer::CoreManager::reset() {
-  mLiveCores = mNumCores;
+  mLiveCores = mNumOwnedCores;
 
   // First resize to zero to delete all of the core status objects, then
   // grow the array again.  This will reinitialise all of the core
@@ -1794,11 +2385,12 @@ void GdbServer::CoreManager::reset() {
 //! Mark 'coreNum' as killed (or exited)
 //
 //! Returns true if coreNum was successfully marked as killed, otherwise
-//! returns false (for example if there is no 'coreNum'.  If 'coreNum' was
-//! already killed then the core remains killed and we return true.
+//! returns false (for example if there is no 'coreNum', or it belongs to
+//! another session).  If 'coreNum' was already killed then the core remains
+//! killed and we return true.
 
 bool GdbServer::CoreManager::killCoreNum(unsigned int coreNum) {
-  if (coreNum < mNumCores) {
+  if (isCoreOwned(coreNum)) {
     mCoreStates[coreNum].killCore();
     --mLiveCores;
     return true;
@@ -1806,3 +2398,16 @@ bool GdbServer::CoreManager::killCoreNum(unsigned int coreNum) {
 
   return false;
 }
+
+//! The action each core was last asked to carry out, suitable for passing
+//! to ITarget::prepare.
+
+std::vector<ITarget::ResumeType>
+GdbServer::CoreManager::resumeActions() const {
+  std::vector<ITarget::ResumeType> actions;
+
+  for (auto &coreState : mCoreStates)
+    actions.push_back(coreState.resumeType());
+
+  return actions;
+}
@@ -13,8 +13,12 @@
 #include <cassert>
 #include <cinttypes>
 #include <map>
+#include <string>
 #include <vector>
 
+#include "EventLoop.h"
+#include "MemoryCache.h"
+#include "PacketTable.h"
 #include "Ptid.h"
 #include "RspPacket.h"
 #include "Timeout.h"
@@ -24,6 +28,7 @@
 namespace EmbDebug {
 
 class AbstractConnection;
+class TargetLock;
 
 //! Module implementing a GDB RSP server.
 
@@ -43,13 +48,31 @@ public:
   // Constructor and destructor
 
   GdbServer(AbstractConnection *_conn, ITarget *_cpu, TraceFlags *traceFlags,
-            KillBehaviour _killBehaviour);
+            KillBehaviour _killBehaviour,
+            const std::vector<unsigned int> &_cores = {},
+            TargetLock *_targetLock = nullptr);
   ~GdbServer();
 
   // Main loop to listen for and service RSP requests.
 
   int rspServer();
 
+  // Should core state survive the client reconnecting?
+
+  void setKeepState(bool keep) { mKeepState = keep; }
+
+  // Line size of the memory cache, or zero to disable it.
+
+  bool setMemCacheLineSize(std::size_t lineSize) {
+    return mMemCache.setLineSize(lineSize);
+  }
+
+  // Bytes of memory to fetch around the PC and SP when a core stops, and
+  // the registers holding them.
+
+  bool setStopPrefetch(int pcRegnum, std::size_t pcBytes, int spRegnum,
+                       std::size_t spBytes);
+
 private:
   //! Definition of GDB target signals.
 
@@ -98,11 +121,22 @@ private:
 
   static const uint32_t BREAK_INSTR = 0x100073;
 
+  //! Line size of the memory cache, if memory is to be prefetched when a
+  //! core stops but no cache has been asked for.
+
+  static const std::size_t DEFAULT_CACHE_LINE = 64;
+
   //! Constant which is the sample period (in instruction steps) during
   //! "continue" etc.
 
   static const int RUN_SAMPLE_PERIOD = 10000;
 
+  //! Longest time (in ms) to sleep while our cores are running, when the
+  //! target is shared with other sessions, before checking whether one of
+  //! them is waiting for it.
+
+  static const int SHARED_POLL_INTERVAL = 10;
+
   //! Our associated simulated CPU
 
   ITarget *cpu;
@@ -115,6 +149,22 @@ private:
 
   AbstractConnection *rsp;
 
+  //! Lock shared with the other sessions using this target, or nullptr if
+  //! we have the target to ourselves.
+
+  TargetLock *mTargetLock;
+
+  //! The current CPU to restore when we take the target back from another
+  //! session.
+
+  unsigned int mCurrentCpu;
+
+  //! The ticket we last held the target lock with, if we have held it, so we
+  //! can tell whether another session has held it since.
+
+  bool mHaveLockTicket;
+  unsigned long mLockTicket;
+
   //! The number of registers in the CPU
   int mNumRegs;
 
@@ -131,6 +181,29 @@ private:
 
   Timeout mTimeout;
 
+  //! Event loop used to sleep while the target is running, if the target can
+  //! tell us when it stops.
+
+  EventLoop mEventLoop;
+
+  //! Target memory held while the cores are halted. This is flushed
+  //! whenever the cores run, the target is reset, another core is chosen or
+  //! another session has had the target.
+
+  MemoryCache mMemCache;
+
+  //! Bytes of memory to fetch into the cache around the PC and above the SP
+  //! when a core stops, or zero for none.
+
+  std::size_t mPrefetchPc;
+  std::size_t mPrefetchSp;
+
+  //! GDB's numbers for the PC and SP registers. The target doesn't tell us
+  //! these, so they must be given before we can prefetch.
+
+  int mPcRegnum;
+  int mSpRegnum;
+
   //! How to behave when we get a kill (k) packet.
 
   KillBehaviour killBehaviour;
@@ -143,10 +216,18 @@ private:
 
   bool mHaveMultiProc;
 
+  //! Whether the client accepts a textual error message in place of E<nn>
+
+  bool mHaveErrorMessage;
+
   //! Stop mode
 
   StopMode mStopMode;
 
+  //! PID to use when GDB lets us choose. This is the first of our cores.
+
+  int mDefaultPid;
+
   //! Current PTID
 
   Ptid mPtid;
@@ -176,15 +257,23 @@ private:
   //! the nicer GDB experience.
   bool mKillCoreOnExit;
 
+  //! When this is true, the state of each core (whether it has exited, and
+  //! any stop not yet reported) is kept when a new client connects, so a
+  //! client can pick up where the last one left off.  When it is false,
+  //! all cores spring back to life on each new connection.
+  bool mKeepState;
+
   //! Class to keep track of the number of cores on the machine, and how
   //! many are still alive.
 
   class CoreManager {
   public:
-    CoreManager(unsigned int count);
+    CoreManager(unsigned int count, const std::vector<unsigned int> &cores);
 
     unsigned int getCpuCount() const { return mNumCores; }
 
+    unsigned int firstCore() const { return mFirstCore; }
+
     unsigned int getLiveCoreCount() const { return mLiveCores; }
 
     static unsigned int pid2CoreNum(unsigned int pid) { return pid - 1; }
@@ -197,10 +286,16 @@ private:
       return mCoreStates[coreNum].isLive();
     }
 
+    bool isCoreOwned(unsigned int coreNum) const {
+      return (coreNum < mNumCores) && mOwnedCores[coreNum];
+    }
+
     bool killCoreNum(unsigned int coreNum);
 
     void reset();
 
+    std::vector<ITarget::ResumeType> resumeActions() const;
+
     //! Class to keep track of the current state of one target core.
 
     class CoreState {
@@ -220,6 +315,8 @@ private:
         return mResumeType != ITarget::ResumeType::NONE;
       }
 
+      ITarget::ResumeType resumeType() const { return mResumeType; }
+
       bool hasUnreportedStop() const { return !mStopReported; }
 
       void reportStopReason() { mStopReported = true; }
@@ -266,9 +363,19 @@ private:
     unsigned int mNumCores;
 
     //! Number of cores that are still live.  Should correspond to the
-    //! number of entries in mCoreLive that are true.
+    //! number of our cores whose CoreState is live.
     unsigned int mLiveCores;
 
+    //! Number of cores this session owns.
+    unsigned int mNumOwnedCores;
+
+    //! The lowest numbered core this session owns.
+    unsigned int mFirstCore;
+
+    //! Which cores belong to this session.  Other cores are never resumed
+    //! or reported to GDB.
+    std::vector<bool> mOwnedCores;
+
     std::vector<CoreState> mCoreStates;
   };
 
@@ -280,6 +387,24 @@ protected:
   void rspClientRequest();
 
 private:
+  // Share the target with other sessions
+  void acquireTarget();
+  void releaseTarget();
+  bool yieldTarget(std::vector<ITarget::ResumeRes> &results);
+
+  // Choose the current core
+  void selectCpu(unsigned int cpuNum);
+
+  // Fetch the memory GDB will want after a stop
+  void prefetchAtStop();
+
+  void rspDispatch();
+
+  // Packets identified by name
+  typedef void (GdbServer::*PktHandler)();
+  static const PacketTable<PktHandler> &namedPackets();
+  void rspNamedPkt();
+
   // Handle the various RSP requests
   uint_reg_t readArgLoc(const ITarget::SyscallArgLoc &loc);
   int stringLength(uint_addr_t addr);
@@ -289,16 +414,26 @@ private:
   void rspReadAllRegs();
   void rspWriteAllRegs();
   void rspReadMem();
+  void rspReadMemBin();
   void rspWriteMem();
+  void rspWriteMemBlock(uint_addr_t addr, const uint8_t *buf, std::size_t len);
   void rspReadReg();
   void rspWriteReg();
-  void rspQuery();
+  void rspQueryCurrentThread();
+  void rspQueryFirstThreadInfo();
+  void rspQueryThreadList();
+  void rspQuerySupported();
+  void rspQuerySymbol();
+  void rspQueryThreadExtraInfo();
+  void rspQueryFeatures();
   void rspCommand();
   void rspSetCommand(const char *cmd);
+  void rspSetOnOff(bool &setting, const std::vector<std::string> &tokens);
   void rspShowCommand(const char *cmd);
-  void rspSet();
+  void rspSetNonStop();
+  void rspStartNoAckMode();
   void rspRestart();
-  void rspVpkt();
+  void rspVContQuery();
   void rspWriteMemBin();
   void rspRemoveMatchpoint();
   void rspInsertMatchpoint();
@@ -6,38 +6,115 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // ----------------------------------------------------------------------------
 
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <thread>
+
 #include "Init.h"
 #include "AbstractConnection.h"
 #include "GdbServer.h"
 #include "RspConnection.h"
 #include "RspPacket.h"
 #include "StreamConnection.h"
+#include "TargetLock.h"
+#include "TraceFlags.h"
 #include "embdebug/ITarget.h"
 
+#ifndef WIN32
+#include "UringConnection.h"
+#endif
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
 using namespace EmbDebug;
 
+//! Create a connection listening on a TCP port, or on a Unix domain socket if
+//! a path is given, using io_uring if asked to.
+
+static AbstractConnection *
+newSocketConnection(TraceFlags *traceFlags, int rspPort, bool writePort,
+                    const std::string &rspSocketPath, bool useIoUring) {
+#ifndef WIN32
+  if (useIoUring) {
+    if (!rspSocketPath.empty())
+      return new UringConnection(rspSocketPath, traceFlags);
+    else
+      return new UringConnection(rspPort, traceFlags, writePort);
+  }
+#else
+  if (useIoUring)
+    cerr << "Warning: io_uring is not available on this host: using plain "
+         << "socket calls" << endl;
+#endif
+
+  if (!rspSocketPath.empty())
+    return new RspConnection(rspSocketPath, traceFlags);
+  else
+    return new RspConnection(rspPort, traceFlags, writePort);
+}
+
+//! Apply the options which belong to each RSP server.
+
+//! @return  TRUE if the options could be applied, FALSE otherwise.
+
+static bool configureServer(GdbServer &server, const ServerOptions &options) {
+  server.setKeepState(options.keepState);
+  server.setMemCacheLineSize(options.memCacheLine);
+
+  if (!server.setStopPrefetch(options.pcRegnum, options.prefetchPc,
+                              options.spRegnum, options.prefetchSp)) {
+    cerr << "ERROR: Memory can only be prefetched around the PC or SP given "
+            "the number of a register the target has"
+         << endl;
+    return false;
+  }
+
+  return true;
+}
+
+//! Set the maximum packet size: the size the user asked for, or failing
+//! that, the size the connection prefers.
+
+static void setPacketSize(AbstractConnection *conn, std::size_t rspBufSize) {
+  if (rspBufSize == 0)
+    rspBufSize = conn->preferredPacketSize();
+
+  RspPacket::setMaxPacketSize(rspBufSize);
+}
+
 int EmbDebug::init(ITarget *target, TraceFlags *traceFlags,
                    bool useStreamConnection, int rspPort,
-                   std::size_t rspBufSize, bool writePort) {
+                   std::size_t rspBufSize, bool writePort,
+                   const ServerOptions &options) {
   assert(target);
   assert(traceFlags);
 
-  // Define the size of a packet before anyone starts using it.
-
-  RspPacket::setMaxPacketSize(rspBufSize);
   AbstractConnection *conn;
   KillBehaviour killBehaviour;
   if (useStreamConnection) {
     conn = new StreamConnection(traceFlags);
     killBehaviour = KillBehaviour::EXIT_ON_KILL;
   } else {
-    conn = new RspConnection(rspPort, traceFlags, writePort);
+    conn = newSocketConnection(traceFlags, rspPort, writePort,
+                               options.rspSocketPath, options.useIoUring);
     killBehaviour = KillBehaviour::RESET_ON_KILL;
   }
 
+  // Define the size of a packet before anyone starts using it.
+
+  setPacketSize(conn, rspBufSize);
+  conn->setRunLengthEncoding(options.useRle);
+
   // The RSP server, connecting it to its CPU.
 
   GdbServer gdbServer(conn, target, traceFlags, killBehaviour);
+  if (!configureServer(gdbServer, options)) {
+    delete conn;
+    return EXIT_FAILURE;
+  }
 
   // Run the GDB server.
 
@@ -49,3 +126,136 @@ int EmbDebug::init(ITarget *target, TraceFlags *traceFlags,
   delete conn;
   return ret;
 }
+
+int EmbDebug::init(ITarget *target, TraceFlags *traceFlags,
+                   const std::vector<std::vector<unsigned int>> &sessionCores,
+                   int rspPort, std::size_t rspBufSize, bool writePort,
+                   const ServerOptions &options) {
+  assert(target);
+  assert(traceFlags);
+
+  // Every session needs some cores, and no core may be in two sessions.
+
+  unsigned int numCores = target->getCpuCount();
+  std::vector<bool> claimed(numCores, false);
+
+  for (auto &cores : sessionCores) {
+    if (cores.empty()) {
+      cerr << "ERROR: GDB session has no cores" << endl;
+      return EXIT_FAILURE;
+    }
+
+    for (auto coreNum : cores) {
+      if (coreNum >= numCores) {
+        cerr << "ERROR: Core " << coreNum << " does not exist: target has "
+             << numCores << " cores" << endl;
+        return EXIT_FAILURE;
+      }
+
+      if (claimed[coreNum]) {
+        cerr << "ERROR: Core " << coreNum << " is in more than one GDB session"
+             << endl;
+        return EXIT_FAILURE;
+      }
+
+      claimed[coreNum] = true;
+    }
+  }
+
+  int numSessions = static_cast<int>(sessionCores.size());
+
+  if (numSessions == 0) {
+    cerr << "ERROR: No GDB sessions" << endl;
+    return EXIT_FAILURE;
+  }
+
+  // Ephemeral ports can't be found from the first, and only the first is
+  // written to the file.
+  if ((rspPort == 0) && writePort && options.rspSocketPath.empty() &&
+      (numSessions > 1)) {
+    cerr << "ERROR: Cannot write the ports of " << numSessions
+         << " GDB sessions on ephemeral ports" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if ((rspPort != 0) && (rspPort + numSessions - 1 > UINT16_MAX)) {
+    cerr << "ERROR: Not enough port numbers for " << sessionCores.size()
+         << " GDB sessions from port " << rspPort << endl;
+    return EXIT_FAILURE;
+  }
+
+  // A connection and an RSP server for each session, all sharing the
+  // target.
+
+  TargetLock targetLock;
+  std::vector<std::unique_ptr<AbstractConnection>> conns;
+  std::vector<std::unique_ptr<GdbServer>> servers;
+
+  for (std::size_t i = 0; i < sessionCores.size(); ++i) {
+    if (!options.rspSocketPath.empty()) {
+      std::string path = options.rspSocketPath + "." + std::to_string(i);
+      conns.emplace_back(newSocketConnection(traceFlags, 0, false, path,
+                                             options.useIoUring));
+
+      if (!traceFlags->traceSilent())
+        cout << "GDB session " << i << " uses socket " << path << endl;
+    } else {
+      int port = (rspPort == 0) ? 0 : rspPort + static_cast<int>(i);
+      conns.emplace_back(newSocketConnection(
+          traceFlags, port, writePort && (i == 0), "", options.useIoUring));
+
+      if (!traceFlags->traceSilent() && (port != 0))
+        cout << "GDB session " << i << " uses port " << port << endl;
+    }
+
+    conns.back()->setRunLengthEncoding(options.useRle);
+    servers.emplace_back(new GdbServer(conns.back().get(), target, traceFlags,
+                                       KillBehaviour::RESET_ON_KILL,
+                                       sessionCores[i], &targetLock));
+    if (!configureServer(*servers.back(), options))
+      return EXIT_FAILURE;
+  }
+
+  // Define the size of a packet before anyone starts using it. The sessions
+  // all use the same kind of connection.
+
+  setPacketSize(conns.front().get(), rspBufSize);
+
+  // Run each RSP server in a thread of its own.
+
+  std::vector<int> results(servers.size(), EXIT_SUCCESS);
+  std::vector<std::thread> threads;
+
+  for (std::size_t i = 0; i < servers.size(); ++i)
+    threads.emplace_back(
+        [&servers, &results, i] { results[i] = servers[i]->rspServer(); });
+
+  for (auto &thread : threads)
+    thread.join();
+
+  for (auto res : results)
+    if (res != EXIT_SUCCESS)
+      return res;
+
+  return EXIT_SUCCESS;
+}
+
+int EmbDebug::init(ITarget *target, TraceFlags *traceFlags,
+                   AbstractConnection *conn, std::size_t rspBufSize) {
+  assert(target);
+  assert(traceFlags);
+  assert(conn);
+
+  // Define the size of a packet before anyone starts using it.
+
+  setPacketSize(conn, rspBufSize);
+
+  // The RSP server, connecting it to its CPU. The connection can't be
+  // reopened, so a kill ends the session.
+
+  GdbServer gdbServer(conn, target, traceFlags, KillBehaviour::EXIT_ON_KILL);
+
+  // Run the GDB server.
+
+  return gdbServer.rspServer();
+}
@@ -10,12 +10,60 @@
 #define EMBDEBUG_INIT_H
 
 #include <cstddef>
+#include <string>
+#include <vector>
 
 namespace EmbDebug {
 
+class AbstractConnection;
 class ITarget;
 class TraceFlags;
 
+//! \brief Options for the GDBServer beyond how to reach the client
+//!
+//! Every option defaults to the behavior of a server without it, so callers
+//! need only set the ones they want.
+struct ServerOptions {
+  ServerOptions()
+      : rspSocketPath(), keepState(false), useIoUring(false), useRle(false),
+        memCacheLine(0), prefetchPc(0), prefetchSp(0), pcRegnum(-1),
+        spRegnum(-1) {}
+
+  //! If not empty, listen on a Unix domain socket at this path instead of
+  //! on a port.
+  std::string rspSocketPath;
+
+  //! True if the state of the cores should be kept when a new client
+  //! connects.
+  bool keepState;
+
+  //! True if socket traffic should go through io_uring, where the host
+  //! supports it.
+  bool useIoUring;
+
+  //! True if runs of repeated chars in replies should be run length encoded.
+  bool useRle;
+
+  //! Line size of the cache of target memory, a power of two, or 0 for no
+  //! cache.
+  std::size_t memCacheLine;
+
+  //! Bytes of memory to fetch around the PC when a core stops, or 0 for
+  //! none.
+  std::size_t prefetchPc;
+
+  //! Bytes of memory to fetch above the SP when a core stops, or 0 for none.
+  std::size_t prefetchSp;
+
+  //! GDB's number for the PC register, or -1 if not known. Needed to
+  //! prefetch around the PC.
+  int pcRegnum;
+
+  //! GDB's number for the SP register, or -1 if not known. Needed to
+  //! prefetch above the SP.
+  int spRegnum;
+};
+
 //! \brief Initialize the GDBServer
 //!
 //! This continually services RSP requests, and does not return until an
@@ -26,11 +74,61 @@ class TraceFlags;
 //! \param[in] useStreamConnection True if RSP traffic uses standard input and
 //!                                output instream of a socket.
 //! \param[in] rspPort    Port number to use for socket communication.
-//! \param[in] rspBufSize  Size of buffer for RSP packets.
+//! \param[in] rspBufSize  Size of buffer for RSP packets, or 0 to use the
+//!                        size preferred by the connection.
 //! \param[in] writePort  True if the used rsp port should be written to a file.
+//! \param[in] options    Any further options.
 //! \return EXIT_SUCCESS on success, or EXIT_FAILURE otherwise.
 int init(ITarget *target, TraceFlags *traceFlags, bool useStreamConnection,
-         int rspPort, std::size_t rspBufSize, bool writePort);
+         int rspPort, std::size_t rspBufSize, bool writePort,
+         const ServerOptions &options = ServerOptions());
+
+//! \brief Initialize the GDBServer with several concurrent sessions
+//!
+//! Each session is a separate GDB connection controlling its own subset of
+//! the target's cores. Session \e i listens on port \p rspPort + \e i, or on
+//! socket \p options.rspSocketPath.\e i. The sessions take turns to use the
+//! target, so while one session's cores are running another session's cores
+//! are stopped.
+//!
+//! This does not return until every session has exited.
+//!
+//! \param[in] target      Interface to the target, non-null.
+//! \param[in] traceFlags  Initial configuration flags for the target,
+//!                        non-null.
+//! \param[in] sessionCores The cores for each session. Each core may belong
+//!                         to at most one session.
+//! \param[in] rspPort     Port number for the first session, or 0 to give
+//!                        each session an ephemeral port.
+//! \param[in] rspBufSize  Size of buffer for RSP packets, or 0 to use the
+//!                        size preferred by the connections.
+//! \param[in] writePort   True if the first session's port should be written
+//!                        to a file. The other sessions use the ports which
+//!                        follow, so this can't be used with ephemeral ports
+//!                        for more than one session.
+//! \param[in] options     Any further options, shared by every session.
+//! \return EXIT_SUCCESS on success, or EXIT_FAILURE otherwise.
+int init(ITarget *target, TraceFlags *traceFlags,
+         const std::vector<std::vector<unsigned int>> &sessionCores,
+         int rspPort, std::size_t rspBufSize, bool writePort,
+         const ServerOptions &options = ServerOptions());
+
+//! \brief Initialize the GDBServer on a connection supplied by the caller
+//!
+//! This is intended for harnesses which drive the server in-process, for
+//! example through a RingConnection. It continually services RSP requests,
+//! and does not return until an error occurs, the connection is closed or
+//! the GDBServer is interrupted. The caller retains ownership of the
+//! connection.
+//!
+//! \param[in] target     Interface to the target, non-null.
+//! \param[in] traceFlags Initial configuration flags for the target, non-null.
+//! \param[in] conn       The connection to the client, non-null.
+//! \param[in] rspBufSize Size of buffer for RSP packets, or 0 to use the
+//!                       size preferred by the connection.
+//! \return EXIT_SUCCESS on success, or EXIT_FAILURE otherwise.
+int init(ITarget *target, TraceFlags *traceFlags, AbstractConnection *conn,
+         std::size_t rspBufSize);
 
 } // namespace EmbDebug
 
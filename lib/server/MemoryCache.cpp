@@ -0,0 +1,274 @@
+// Cache of target memory: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+
+#include "MemoryCache.h"
+#include "embdebug/ITarget.h"
+
+using namespace EmbDebug;
+
+//! Constructor
+
+//! The cache starts off disabled.
+
+//! @param[in] _target  The target whose memory we hold
+
+MemoryCache::MemoryCache(ITarget *_target)
+    : mTarget(_target), mVectored(_target->getVectored()),
+      mLineSize(0) {}
+
+//! Set the size of a line
+
+//! Anything held is forgotten.
+
+//! @param[in] lineSize  The size of a line in bytes, which must be a power of
+//!                      two, or zero to disable the cache.
+//! @return  True if the size was set, false if it is not a power of two.
+
+bool MemoryCache::setLineSize(std::size_t lineSize) {
+  if ((lineSize & (lineSize - 1)) != 0)
+    return false;
+
+  flush();
+  mLineSize = lineSize;
+  return true;
+}
+
+//! Read memory
+
+//! Any lines covering the memory which are not yet held are read from the
+//! target first. Memory which may not be cached, or which the target could
+//! not read a whole line of, is then read straight from the target.
+
+//! @param[in]  addr  Where to read
+//! @param[out] buf   Where to put the bytes read
+//! @param[in]  len   The number of bytes to read
+//! @return  The number of bytes read, which is less than len if the target
+//!          could not read them all.
+
+std::size_t MemoryCache::read(uint_addr_t addr, uint8_t *buf,
+                              std::size_t len) {
+  uint_addr_t last = addr + len - 1;
+
+  // No caching if disabled, and don't try to be clever at the top of memory
+  if ((mLineSize == 0) || (len == 0) || (last < addr))
+    return mTarget->read(addr, buf, len);
+
+  fetch(std::vector<Range>(1, Range(addr, len)), false);
+
+  // Copy out what we hold, and read the rest from the target
+  std::size_t done = 0;
+
+  while (done < len) {
+    uint_addr_t line = lineAddr(addr + done);
+    std::size_t offset = static_cast<std::size_t>(addr + done - line);
+    std::size_t n = mLineSize - offset;
+
+    if (n > len - done)
+      n = len - done;
+
+    if (isHeld(line)) {
+      memcpy(&buf[done], mLines[line].data() + offset, n);
+      done += n;
+      continue;
+    }
+
+    // Read up to the next line we hold in one go
+    while ((done + n < len) && !isHeld(addr + done + n))
+      n += (len - done - n < mLineSize) ? len - done - n : mLineSize;
+
+    std::size_t count = mTarget->read(addr + done, &buf[done], n);
+
+    if (count < n)
+      return done + count;
+
+    done += n;
+  }
+
+  return done;
+}
+
+//! Write memory
+
+//! The bytes go straight to the target, and those it writes are copied into
+//! any lines holding them.
+
+//! @param[in] addr  Where to write
+//! @param[in] buf   The bytes to write
+//! @param[in] len   The number of bytes to write
+//! @return  The number of bytes the target wrote.
+
+std::size_t MemoryCache::write(uint_addr_t addr, const uint8_t *buf,
+                               std::size_t len) {
+  std::size_t count = mTarget->write(addr, buf, len);
+  std::size_t n = (count < len) ? count : len;
+  uint_addr_t last = addr + n - 1;
+
+  if ((mLineSize == 0) || (n == 0) || mLines.empty())
+    return count;
+
+  if (last < addr) {
+    flush();
+    return count;
+  }
+
+  for (auto it = mLines.lower_bound(lineAddr(addr));
+       (it != mLines.end()) && (it->first <= last); ++it) {
+    if (it->second.empty())
+      continue;
+
+    uint_addr_t from = (it->first < addr) ? addr : it->first;
+    uint_addr_t to = it->first + mLineSize - 1;
+
+    if (to > last)
+      to = last;
+
+    memcpy(it->second.data() + (from - it->first), &buf[from - addr],
+           static_cast<std::size_t>(to - from + 1));
+  }
+
+  return count;
+}
+
+//! Fetch memory we expect to be asked for
+
+//! The lines covering the memory are read, so that a later read of them
+//! will not need to go to the target. As nobody has asked for the memory
+//! yet, memory the target can't read is not remembered as unreadable.
+
+//! @param[in] ranges  The start and length of each range of memory
+
+void MemoryCache::prefetch(std::vector<Range> ranges) {
+  if (mLineSize == 0)
+    return;
+
+  for (auto it = ranges.begin(); it != ranges.end();) {
+    // Stop at the top of memory
+    if (it->first + it->second - 1 < it->first)
+      it->second = static_cast<std::size_t>(~it->first) + 1;
+
+    if (it->second == 0)
+      it = ranges.erase(it);
+    else
+      ++it;
+  }
+
+  fetch(ranges, true);
+}
+
+//! Is a line held with its contents?
+
+bool MemoryCache::isHeld(uint_addr_t line) const {
+  auto it = mLines.find(line);
+  return (it != mLines.end()) && !it->second.empty();
+}
+
+//! Read the lines covering some memory which are not yet held
+
+//! Missing lines next to each other are read as one range, and all the
+//! ranges are read together. Only the lines the target read completely are
+//! held. Unless the read is speculative, the rest are held empty, so they
+//! will be read straight from the target from now on.
+
+//! @param[in] ranges       The start and length of each range of memory.
+//!                         None may be empty or run past the top of memory.
+//! @param[in] speculative  True if nobody has asked for the memory yet
+
+void MemoryCache::fetch(std::vector<Range> ranges, bool speculative) {
+  // Look at the lines in address order, so those each range shares with
+  // the one before are only looked at once.
+  std::sort(ranges.begin(), ranges.end());
+
+  std::vector<Range> runs; // Missing lines, as start and length
+  uint_addr_t seen = 0;    // The last line looked at
+  bool haveSeen = false;
+
+  for (auto &range : ranges) {
+    uint_addr_t line = lineAddr(range.first);
+    uint_addr_t last = lineAddr(range.first + range.second - 1);
+
+    if (haveSeen && (line <= seen)) {
+      if (last <= seen)
+        continue;
+
+      line = seen + mLineSize;
+    }
+
+    for (;; line += mLineSize) {
+      bool missing = (mLines.find(line) == mLines.end());
+
+      if (missing && !mTarget->isCacheable(line, mLineSize)) {
+        mLines[line].clear();
+        missing = false;
+      }
+
+      if (missing) {
+        if (!runs.empty() && (runs.back().first + runs.back().second == line))
+          runs.back().second += mLineSize;
+        else
+          runs.push_back(Range(line, mLineSize));
+      }
+
+      if (line == last)
+        break;
+    }
+
+    seen = last;
+    haveSeen = true;
+  }
+
+  if (runs.empty())
+    return;
+
+  // Read all the runs into one buffer
+  std::size_t total = 0;
+
+  for (auto &run : runs)
+    total += run.second;
+
+  std::vector<uint8_t> buf(total);
+  std::vector<ITargetVectored::ReadAccess> accesses;
+  uint8_t *next = buf.data();
+
+  for (auto &run : runs) {
+    accesses.push_back({run.first, next, run.second, 0});
+    next += run.second;
+  }
+
+  readRanges(accesses);
+
+  for (auto &access : accesses) {
+    for (std::size_t i = 0; i < access.size; i += mLineSize) {
+      if (i + mLineSize <= access.count)
+        mLines[access.addr + i].assign(&access.buffer[i],
+                                       &access.buffer[i] + mLineSize);
+      else if (!speculative)
+        mLines[access.addr + i].clear();
+    }
+  }
+}
+
+//! Read several ranges of memory from the target
+
+//! If the target provides ITargetVectored they are read in one call,
+//! otherwise each is read in turn.
+
+//! @param[in,out] accesses  The ranges to read
+
+void MemoryCache::readRanges(
+    std::vector<ITargetVectored::ReadAccess> &accesses) {
+  if (mVectored != nullptr) {
+    (void)mVectored->readv(accesses);
+    return;
+  }
+
+  for (auto &access : accesses)
+    access.count = mTarget->read(access.addr, access.buffer, access.size);
+}
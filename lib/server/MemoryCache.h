@@ -0,0 +1,104 @@
+// Cache of target memory: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef MEMORY_CACHE_H
+#define MEMORY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "embdebug/ITargetVectored.h"
+#include "embdebug/Types.h"
+
+namespace EmbDebug {
+
+class ITarget;
+
+//! Class caching target memory while the cores are halted
+
+//! GDB reads the same stack and code again and again after each stop. On a
+//! slow target each of those reads is costly, so memory is held in lines of
+//! a fixed size, and only lines not yet held are read from the target.
+//! Lines which are missing next to each other are read as one range, and if
+//! the target provides ITargetVectored, all the ranges needed are read with
+//! a single call.
+
+//! Writes go straight to the target, so any error is seen at once, and the
+//! bytes written are copied into any lines holding them.
+
+//! The cache knows nothing of when the target changes memory itself. It
+//! must be flushed whenever the cores run, the target is reset, or anyone
+//! else may have used the target.
+
+//! With a line size of zero the cache is disabled, and all reads and writes
+//! go straight to the target.
+
+class MemoryCache {
+public:
+  // Constructor
+
+  MemoryCache(ITarget *_target);
+
+  // Size of a line, or zero if disabled
+
+  bool setLineSize(std::size_t lineSize);
+  std::size_t getLineSize() const { return mLineSize; }
+
+  // Access memory through the cache
+
+  std::size_t read(uint_addr_t addr, uint8_t *buf, std::size_t len);
+  std::size_t write(uint_addr_t addr, const uint8_t *buf, std::size_t len);
+
+  // Fetch memory we expect to be asked for
+
+  typedef std::pair<uint_addr_t, std::size_t> Range;
+
+  void prefetch(std::vector<Range> ranges);
+
+  // Forget everything held
+
+  void flush() { mLines.clear(); }
+
+private:
+  //! The target whose memory we hold
+
+  ITarget *mTarget;
+
+  //! The target's vectored access interface, or nullptr if it has none
+
+  ITargetVectored *mVectored;
+
+  //! Size of a line in bytes. Always a power of two, or zero if the cache is
+  //! disabled.
+
+  std::size_t mLineSize;
+
+  //! The lines held, by the address of their first byte. A line which may
+  //! not be cached, or which the target could not read in full, is held
+  //! empty, so we need not ask the target again.
+
+  std::map<uint_addr_t, std::vector<uint8_t>> mLines;
+
+  // Helpers
+
+  bool isHeld(uint_addr_t line) const;
+
+  uint_addr_t lineAddr(uint_addr_t addr) const {
+    return addr & ~static_cast<uint_addr_t>(mLineSize - 1);
+  }
+
+  void fetch(std::vector<Range> ranges, bool speculative);
+  void readRanges(std::vector<ITargetVectored::ReadAccess> &accesses);
+};
+
+} // namespace EmbDebug
+
+#endif
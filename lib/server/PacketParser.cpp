@@ -0,0 +1,140 @@
+// Cursor for parsing RSP packets: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+
+#include "PacketParser.h"
+
+using namespace EmbDebug;
+
+//! Take a given char
+
+//! @param[in] c  The char expected next
+//! @return  TRUE if it was next, FALSE otherwise.
+
+bool PacketParser::expect(char c) {
+  if ((mPos == mEnd) || (*mPos != c))
+    return false;
+
+  mPos++;
+  return true;
+}
+
+//! Take some given text
+
+//! @param[in] str  The text expected next
+//! @return  TRUE if it was next, FALSE otherwise.
+
+bool PacketParser::expect(const char *str) {
+  std::size_t len = strlen(str);
+
+  if ((static_cast<std::size_t>(mEnd - mPos) < len) ||
+      (memcmp(mPos, str, len) != 0))
+    return false;
+
+  mPos += len;
+  return true;
+}
+
+//! Take some chars, whatever they are
+
+//! @param[in] n  The number of chars to take
+//! @return  TRUE if there were that many chars left, FALSE otherwise.
+
+bool PacketParser::skip(std::size_t n) {
+  if (static_cast<std::size_t>(mEnd - mPos) < n)
+    return false;
+
+  mPos += n;
+  return true;
+}
+
+//! Take a hex number
+
+//! Upper and lower case digits are accepted. There must be at least one
+//! digit, and the value must fit in 64 bits.
+
+//! @param[out] val  The number
+//! @return  TRUE if a number was taken, FALSE otherwise.
+
+bool PacketParser::hex(uint64_t &val) {
+  const char *start = mPos;
+  uint64_t v = 0;
+
+  for (; mPos != mEnd; mPos++) {
+    char c = *mPos;
+    unsigned int digit;
+
+    if ((c >= '0') && (c <= '9'))
+      digit = c - '0';
+    else if ((c >= 'a') && (c <= 'f'))
+      digit = c - 'a' + 10;
+    else if ((c >= 'A') && (c <= 'F'))
+      digit = c - 'A' + 10;
+    else
+      break;
+
+    if ((v >> 60) != 0) {
+      mPos = start; // Too big
+      return false;
+    }
+
+    v = (v << 4) | digit;
+  }
+
+  if (mPos == start)
+    return false;
+
+  val = v;
+  return true;
+}
+
+//! Take a process/thread ID
+
+//! The ID runs to the next ';' or the end of the packet.
+
+//! @param[out] ptid  The ID
+//! @return  TRUE if a valid ID was taken, FALSE otherwise, in which case
+//!          ptid is unchanged.
+
+bool PacketParser::ptid(Ptid &ptid) {
+  const char *start = mPos;
+
+  if (!ptid.decode(field(';'))) {
+    mPos = start;
+    return false;
+  }
+
+  return true;
+}
+
+//! Take a field running up to a delimiter, or the end of the packet
+
+//! @param[in] delim  The delimiter, which is left to be taken next
+//! @return  The field, which may be empty.
+
+ByteView PacketParser::field(char delim) {
+  const char *start = mPos;
+  const char *found =
+      (mPos == mEnd)
+          ? nullptr
+          : static_cast<const char *>(memchr(mPos, delim, mEnd - mPos));
+
+  mPos = (found != nullptr) ? found : mEnd;
+  return ByteView(start, mPos - start);
+}
+
+//! Take the rest of the packet
+
+//! @return  Whatever is left, which may be empty.
+
+ByteView PacketParser::rest() {
+  ByteView r(mPos, mEnd - mPos);
+  mPos = mEnd;
+  return r;
+}
@@ -0,0 +1,82 @@
+// Cursor for parsing RSP packets: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H
+
+#include <cstdint>
+#include <limits>
+
+#include "Ptid.h"
+#include "embdebug/ByteView.h"
+
+namespace EmbDebug {
+
+//! Class to parse the fields of an RSP packet
+
+//! A cursor moves through the packet as each field is taken. Nothing is
+//! copied or allocated, and the packet need not be zero terminated.
+
+//! If a field can't be taken, the method taking it returns FALSE and the
+//! cursor stays where it was, so that checks can be chained with &&.
+
+class PacketParser {
+public:
+  // Constructor
+
+  explicit PacketParser(ByteView view)
+      : mPos(view.getData()), mEnd(view.getData() + view.getLen()) {}
+
+  // Where are we?
+
+  bool atEnd() const { return mPos == mEnd; }
+
+  // Take literal text
+
+  bool expect(char c);
+  bool expect(const char *str);
+  bool skip(std::size_t n);
+
+  // Take a field
+
+  bool hex(uint64_t &val);
+  bool ptid(Ptid &ptid);
+  ByteView field(char delim);
+  ByteView rest();
+
+  //! Take a hex number, which must fit the type of the result
+
+  template <typename T> bool hex(T &val) {
+    const char *start = mPos;
+    uint64_t v;
+
+    if (!hex(v))
+      return false;
+
+    if (v > std::numeric_limits<T>::max()) {
+      mPos = start;
+      return false;
+    }
+
+    val = static_cast<T>(v);
+    return true;
+  }
+
+private:
+  //! The next char to be parsed
+
+  const char *mPos;
+
+  //! One past the last char of the packet
+
+  const char *mEnd;
+};
+
+} // namespace EmbDebug
+
+#endif
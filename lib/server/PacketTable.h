@@ -0,0 +1,137 @@
+// Table of named RSP packets: declaration and implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef PACKET_TABLE_H
+#define PACKET_TABLE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "embdebug/ByteView.h"
+
+namespace EmbDebug {
+
+//! Class mapping the names of RSP packets to their handlers
+
+//! Packets such as the 'q', 'Q' and 'v' packets are identified by a name
+//! rather than a single char. Handlers are registered either for a packet
+//! which must match the name exactly (such as "qC"), or for any packet
+//! starting with a prefix (such as "qRcmd,").
+
+//! The names are held in a trie, so finding the handler for a packet only
+//! looks at each char of its name once, however many packets are
+//! registered. Where several prefixes match, the longest wins, and an exact
+//! match beats any prefix.
+
+template <typename Handler> class PacketTable {
+public:
+  // Constructor
+
+  PacketTable() : mNodes(1) {}
+
+  // Register handlers
+
+  void addExact(const char *name, Handler handler) {
+    mNodes[findOrAdd(name)].exact = handler;
+  }
+
+  void addPrefix(const char *prefix, Handler handler) {
+    mNodes[findOrAdd(prefix)].prefix = handler;
+  }
+
+  //! Find the handler for a packet
+
+  //! @param[in] pkt  The packet
+  //! @return  The handler, or nullptr if no packet name matches.
+
+  Handler lookup(ByteView pkt) const {
+    Handler found = nullptr; // Longest matching prefix so far
+    std::size_t node = 0;
+
+    for (std::size_t i = 0; i < pkt.getLen(); i++) {
+      if (mNodes[node].prefix != nullptr)
+        found = mNodes[node].prefix;
+
+      node = child(node, pkt[i]);
+
+      if (node == NO_NODE)
+        return found;
+    }
+
+    if (mNodes[node].exact != nullptr)
+      return mNodes[node].exact;
+
+    return (mNodes[node].prefix != nullptr) ? mNodes[node].prefix : found;
+  }
+
+private:
+  //! Marks a missing child
+
+  static const std::size_t NO_NODE = 0;
+
+  //! A node of the trie. The root represents the empty name, and each
+  //! child adds one more char.
+
+  struct Node {
+    Node() : exact(nullptr), prefix(nullptr) {}
+
+    //! The next char of each longer name, and the node for it
+
+    std::vector<std::pair<char, std::size_t>> children;
+
+    //! Handler for a packet with exactly this name
+
+    Handler exact;
+
+    //! Handler for a packet starting with this name
+
+    Handler prefix;
+  };
+
+  //! The nodes, the root first
+
+  std::vector<Node> mNodes;
+
+  //! Find a child of a node
+
+  //! @return  The child, or NO_NODE if there is none (the root is never a
+  //!          child).
+
+  std::size_t child(std::size_t node, char ch) const {
+    for (auto &c : mNodes[node].children)
+      if (c.first == ch)
+        return c.second;
+
+    return NO_NODE;
+  }
+
+  //! Find the node for a name, adding any nodes needed
+
+  std::size_t findOrAdd(const char *name) {
+    std::size_t node = 0;
+
+    for (; *name != '\0'; name++) {
+      std::size_t next = child(node, *name);
+
+      if (next == NO_NODE) {
+        next = mNodes.size();
+        mNodes[node].children.push_back(std::make_pair(*name, next));
+        mNodes.emplace_back();
+      }
+
+      node = next;
+    }
+
+    return node;
+  }
+};
+
+} // namespace EmbDebug
+
+#endif
@@ -7,12 +7,14 @@
 // ----------------------------------------------------------------------------
 
 #include <cstring>
+#include <string>
 
 #include "Ptid.h"
 #include "Utils.h"
 
 using std::cerr;
 using std::endl;
+using std::string;
 
 using namespace EmbDebug;
 
@@ -164,41 +166,44 @@ bool Ptid::validate() {
 //! @return TRUE if successfully parsed, FALSE otherwise (in which case the
 //!         values in mPid and mTid are unchanged).
 
-bool Ptid::decode(const char *buf) {
+bool Ptid::decode(ByteView buf) {
   int pid;
   int tid;
-  const char *ptr; // Pointer into the buffer
+  std::size_t dot = buf.find('.');
 
   // break out formats
 
-  if (buf[0] != 'p') {
+  if ((0 == buf.getLen()) || (buf[0] != 'p')) {
     // Simplest format. Just a TID. We leave PID unchanged.
 
     pid = mPid;
-    tid = decodeField(buf, strlen(buf));
+    tid = decodeField(buf.getData(), buf.getLen());
 
     if (PTID_INV == tid) {
-      cerr << "Warning: Invalid TID, " << buf << ": ignored." << endl;
+      cerr << "Warning: Invalid TID, " << string(buf.getData(), buf.getLen())
+           << ": ignored." << endl;
       return false;
     }
-  } else if (nullptr == (ptr = strchr(buf, '.'))) {
+  } else if (ByteView::n_pos == dot) {
     // Just a PID
 
-    pid = decodeField(&(buf[1]), strlen(&(buf[1])));
+    pid = decodeField(&(buf.getData()[1]), buf.getLen() - 1);
     tid = PTID_ALL;
 
     if (PTID_INV == pid) {
-      cerr << "Warning: Invalid PID, " << buf << ": ignored." << endl;
+      cerr << "Warning: Invalid PID, " << string(buf.getData(), buf.getLen())
+           << ": ignored." << endl;
       return false;
     }
   } else {
     // A PTID
 
-    pid = decodeField(&(buf[1]), ptr - buf - 1);
-    tid = decodeField(&(ptr[1]), strlen(&(ptr[1])));
+    pid = decodeField(&(buf.getData()[1]), dot - 1);
+    tid = decodeField(&(buf.getData()[dot + 1]), buf.getLen() - dot - 1);
 
     if ((PTID_INV == pid) || (PTID_INV == tid)) {
-      cerr << "Warning: Invalid PTID, " << buf << ": ignored." << endl;
+      cerr << "Warning: Invalid PTID, " << string(buf.getData(), buf.getLen())
+           << ": ignored." << endl;
       return false;
     }
   }
@@ -206,7 +211,8 @@ bool Ptid::decode(const char *buf) {
   // Rule out an invalid combination.
 
   if ((PTID_ALL == pid) & ((PTID_ALL == tid) || (PTID_ANY == tid))) {
-    cerr << "Warning: Invalid PTID, " << buf << ": ignored." << endl;
+    cerr << "Warning: Invalid PTID, " << string(buf.getData(), buf.getLen())
+         << ": ignored." << endl;
     return false;
   }
 
@@ -11,6 +11,8 @@
 
 #include <iostream>
 
+#include "embdebug/ByteView.h"
+
 namespace EmbDebug {
 
 //! Module representing a PTID.
@@ -31,7 +33,7 @@ public:
 
   // I/O functions
 
-  bool decode(const char *buf);
+  bool decode(ByteView buf);
   bool encode(char *buf);
   bool crystalize(const int defaultPid, const int defaultTid);
   bool validate();
@@ -0,0 +1,196 @@
+// Shared memory ring buffer RSP connection: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "RingConnection.h"
+
+using std::cerr;
+using std::endl;
+
+using namespace EmbDebug;
+
+// Definition of the ring capacity, so it may be ODR-used.
+const std::size_t RspRing::RING_SIZE;
+
+//! Write characters into the ring without blocking
+
+//! @param[in] buf  The characters to write
+//! @param[in] len  The number of characters to write
+//! @return  The number of characters written, which may be less than len if
+//!          the ring is full.
+
+std::size_t RspRing::write(const char *buf, std::size_t len) {
+  std::size_t head = mHead.load(std::memory_order_relaxed);
+  std::size_t tail = mTail.load(std::memory_order_acquire);
+  std::size_t count = std::min(len, RING_SIZE - (head - tail));
+
+  for (std::size_t i = 0; i < count; i++)
+    mData[(head + i) & (RING_SIZE - 1)] = buf[i];
+
+  mHead.store(head + count, std::memory_order_release);
+  return count;
+}
+
+//! Read characters from the ring without blocking
+
+//! @param[out] buf  Buffer for the characters read
+//! @param[in]  len  The size of the buffer
+//! @return  The number of characters read, which may be zero if the ring is
+//!          empty.
+
+std::size_t RspRing::read(char *buf, std::size_t len) {
+  std::size_t tail = mTail.load(std::memory_order_relaxed);
+  std::size_t head = mHead.load(std::memory_order_acquire);
+  std::size_t count = std::min(len, head - tail);
+
+  for (std::size_t i = 0; i < count; i++)
+    buf[i] = mData[(tail + i) & (RING_SIZE - 1)];
+
+  mTail.store(tail + count, std::memory_order_release);
+  return count;
+}
+
+//! Is the ring empty?
+
+//! @return  TRUE if there are no characters to read.
+
+bool RspRing::empty() const {
+  return mHead.load(std::memory_order_acquire) ==
+         mTail.load(std::memory_order_acquire);
+}
+
+//! Constructor
+
+//! @param[in] _channel     The channel to the client
+//! @param[in] _traceFlags  flags controlling tracing
+RingConnection::RingConnection(RspRingChannel *_channel,
+                               TraceFlags *_traceFlags)
+    : AbstractConnection(_traceFlags), mChannel(_channel),
+      mIsConnected(true) {}
+
+//! Destructor
+
+//! Close the connection if it is still open
+RingConnection::~RingConnection() { this->rspClose(); }
+
+//! Get a new client connection.
+
+//! The channel is set up by the client before we are created, so we are
+//! connected from the start and can't reconnect once closed.
+
+//! @return  FALSE, since we can never reconnect.
+bool RingConnection::rspConnect() { return false; }
+
+//! Close the connection, telling the client.
+void RingConnection::rspClose() {
+  if (mIsConnected) {
+    mChannel->closed.store(true, std::memory_order_release);
+    mIsConnected = false;
+  }
+}
+
+//! Report if we are connected to a client.
+
+//! @return  TRUE if we are connected, FALSE otherwise
+bool RingConnection::isConnected() {
+  return mIsConnected && !mChannel->closed.load(std::memory_order_acquire);
+}
+
+//! Put a single character out on the RSP connection
+
+//! @param[in] c  The character to put out
+//! @return  TRUE if char sent OK, FALSE if not (communications failure)
+
+bool RingConnection::putRspCharRaw(char c) {
+  return putRspBytesRaw(&c, sizeof(c));
+}
+
+//! Get a single character from the RSP connection
+
+//! @param[in] blocking  True if the read should block.
+//! @return  The character received or -1 on failure, or if the read would
+//!          block, and blocking is true.
+
+int RingConnection::getRspCharRaw(bool blocking) {
+  char c;
+
+  if (1 != getRspBytesRaw(&c, sizeof(c), blocking))
+    return -1;
+
+  return c & 0xff; // Success, we can return (no sign extend!)
+}
+
+//! Put a buffer of characters out on the RSP connection
+
+//! Waits for the client to make space in the ring if necessary.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+//! @return  TRUE if all chars sent OK, FALSE if the channel was closed.
+
+bool RingConnection::putRspBytesRaw(const char *buf, std::size_t len) {
+  int spins = 0;
+
+  while (len > 0) {
+    if (!isConnected()) {
+      cerr << "Warning: Attempt to write " << len
+           << " chars to closed RSP ring: Ignored" << endl;
+      return false;
+    }
+
+    std::size_t count = mChannel->toClient.write(buf, len);
+    if (count > 0) {
+      buf += count;
+      len -= count;
+      spins = 0;
+    } else
+      backoff(spins);
+  }
+
+  return true;
+}
+
+//! Get as many characters as are available from the RSP connection
+
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters received or -1 on failure, or if the
+//!          read would block, and blocking is false.
+
+int RingConnection::getRspBytesRaw(char *buf, std::size_t len, bool blocking) {
+  int spins = 0;
+
+  for (;;) {
+    std::size_t count = mChannel->toServer.read(buf, len);
+    if (count > 0)
+      return static_cast<int>(count);
+
+    if (!blocking || !isConnected())
+      return -1;
+
+    backoff(spins);
+  }
+}
+
+//! Wait a little for the client
+
+//! Spin for a while, since the client is usually quick to respond, then
+//! start yielding the processor.
+
+//! @param[in,out] spins  Number of times we have waited so far
+
+void RingConnection::backoff(int &spins) {
+  if (spins < SPIN_COUNT)
+    spins++;
+  else
+    std::this_thread::yield();
+}
@@ -0,0 +1,126 @@
+// Shared memory ring buffer RSP connection: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef RING_CONNECTION_H
+#define RING_CONNECTION_H
+
+#include <atomic>
+#include <cstddef>
+
+#include "AbstractConnection.h"
+
+namespace EmbDebug {
+
+//! Lock-free single-producer/single-consumer ring of characters.
+
+//! The ring is self contained (no pointers), so it may be placed in memory
+//! shared between threads or processes. Exactly one thread may write, and
+//! exactly one thread may read.
+
+class RspRing {
+public:
+  //! Capacity of the ring. Must be a power of 2.
+
+  static const std::size_t RING_SIZE = 65536;
+
+  // Constructor
+
+  RspRing() : mHead(0), mTail(0) {}
+
+  // Non-blocking transfer of characters
+
+  std::size_t write(const char *buf, std::size_t len);
+  std::size_t read(char *buf, std::size_t len);
+
+  bool empty() const;
+
+private:
+  //! Padding to keep the producer and consumer indices in separate cache
+  //! lines.
+
+  static const std::size_t CACHE_LINE_SIZE = 64;
+
+  //! Total characters ever written. Only updated by the producer.
+
+  std::atomic<std::size_t> mHead;
+  char mHeadPad[CACHE_LINE_SIZE - sizeof(std::atomic<std::size_t>)];
+
+  //! Total characters ever read. Only updated by the consumer.
+
+  std::atomic<std::size_t> mTail;
+  char mTailPad[CACHE_LINE_SIZE - sizeof(std::atomic<std::size_t>)];
+
+  //! The characters.
+
+  char mData[RING_SIZE];
+};
+
+//! A pair of rings forming a bidirectional channel between an in-process
+//! GDB front end (the client) and the GDB server.
+
+struct RspRingChannel {
+  RspRingChannel() : closed(false) {}
+
+  //! Characters from the client to the server
+
+  RspRing toServer;
+
+  //! Characters from the server to the client
+
+  RspRing toClient;
+
+  //! Set by either end to close the channel
+
+  std::atomic<bool> closed;
+};
+
+//! Class implementing an RSP connection over a shared memory ring channel.
+
+//! There are no system calls on the data path. Blocking reads and writes spin
+//! briefly, then yield the processor while waiting for the other end.
+
+class RingConnection : public AbstractConnection {
+public:
+  // Constructors and destructor
+
+  RingConnection(RspRingChannel *_channel, TraceFlags *_traceFlags);
+  ~RingConnection();
+
+  // Public interface: manage client connections
+
+  virtual bool rspConnect();
+  virtual void rspClose();
+  virtual bool isConnected();
+  virtual bool isReliable() { return true; }
+
+private:
+  //! Number of times to spin before yielding when waiting
+
+  static const int SPIN_COUNT = 1000;
+
+  //! The channel to the client
+
+  RspRingChannel *mChannel;
+
+  //! Track whether we are connected or not.
+
+  bool mIsConnected;
+
+  // Implementation specific routines to handle chars.
+
+  virtual bool putRspCharRaw(char c);
+  virtual int getRspCharRaw(bool blocking);
+  virtual bool putRspBytesRaw(const char *buf, std::size_t len);
+  virtual int getRspBytesRaw(char *buf, std::size_t len, bool blocking);
+
+  void backoff(int &spins);
+};
+
+} // namespace EmbDebug
+
+#endif
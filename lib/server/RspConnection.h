@@ -9,6 +9,8 @@
 #ifndef RSP_CONNECTION_H
 #define RSP_CONNECTION_H
 
+#include <string>
+
 #include "AbstractConnection.h"
 
 // This provides a valid typedef for the Windows SOCKET type, but avoids pulling
@@ -36,6 +38,7 @@ public:
   // Constructors and destructor
 
   RspConnection(int _portNum, TraceFlags *_traceFlags, bool _writePort);
+  RspConnection(const std::string &_socketPath, TraceFlags *_traceFlags);
   ~RspConnection();
 
   // Public interface: manage client connections
@@ -43,12 +46,29 @@ public:
   bool rspConnect();
   void rspClose();
   bool isConnected();
+  virtual int getFd();
+  virtual bool isReliable() { return true; }
 
 private:
   //! The port number to listen on
 
   int portNum;
 
+  //! The path of the Unix domain socket to listen on. If empty, we listen
+  //! on the TCP port instead.
+
+  std::string socketPath;
+
+  //! The listening file descriptor/socket. This is opened by the first
+  //! call to rspConnect and kept open, so that reconnecting only needs an
+  //! accept.
+
+#ifdef WIN32
+  SOCKET listenSock;
+#else
+  int listenFd;
+#endif
+
   //! The client file descriptor/socket
 
 #ifdef WIN32
@@ -61,10 +81,25 @@ private:
 
   bool writePort;
 
-  // Implementation specific routines to handle individual chars.
+#ifndef WIN32
+  //! Did we create the Unix domain socket in the file system? Only then is
+  //! it ours to remove.
+
+  bool socketBound;
+
+  // Implementation specific routines to open a listening socket.
+
+  int listenTcp();
+  int listenUnix();
+#endif
+
+protected:
+  // Implementation specific routines to handle chars.
 
   virtual bool putRspCharRaw(char c);
   virtual int getRspCharRaw(bool blocking);
+  virtual bool putRspBytesRaw(const char *buf, std::size_t len);
+  virtual int getRspBytesRaw(char *buf, std::size_t len, bool blocking);
 };
 
 } // namespace EmbDebug
@@ -20,6 +20,8 @@
 #include <netinet/tcp.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include "RspConnection.h"
@@ -44,14 +46,32 @@ using namespace EmbDebug;
 //! @param[in] _traceFlags  flags controlling tracing
 RspConnection::RspConnection(int _portNum, TraceFlags *_traceFlags,
                              bool _writePort)
-    : AbstractConnection(_traceFlags), portNum(_portNum), clientFd(-1),
-      writePort(_writePort) {}
+    : AbstractConnection(_traceFlags), portNum(_portNum), socketPath(),
+      listenFd(-1), clientFd(-1), writePort(_writePort), socketBound(false) {}
+
+//! Constructor when using a Unix domain socket
+
+//! Sets up various parameters
+
+//! @param[in] _socketPath  the path of the socket to listen on
+//! @param[in] _traceFlags  flags controlling tracing
+RspConnection::RspConnection(const std::string &_socketPath,
+                             TraceFlags *_traceFlags)
+    : AbstractConnection(_traceFlags), portNum(0), socketPath(_socketPath),
+      listenFd(-1), clientFd(-1), writePort(false), socketBound(false) {}
 
 //! Destructor
 
-//! Close the connection if it is still open
+//! Close the connection if it is still open, stop listening, and remove any
+//! Unix domain socket we created.
 RspConnection::~RspConnection() {
   this->rspClose(); // Don't confuse with any other close ()
+
+  if (-1 != listenFd)
+    close(listenFd);
+
+  if (socketBound)
+    unlink(socketPath.c_str());
 }
 
 //! Get a new client connection.
@@ -62,25 +82,73 @@ RspConnection::~RspConnection() {
 
 //! This involves setting up a socket to listen on a socket for attempted
 //! connections from a single GDB instance (we couldn't be talking to multiple
-//! GDBs at once!).
-
-//! The service is specified either as a port number in the Or1ksim
-//! configuration (parameter rsp_port in section debug, default 51000) or as a
-//! service name in the constant OR1KSIM_RSP_SERVICE.
-
-//! If there is a catastrophic communication failure, service will be
-//! terminated using sc_stop.
+//! GDBs at once!). The listening socket is only set up the first time, and
+//! then kept for later connections, so a reconnecting client never has to
+//! wait for the port to be bound again.
 
-//! The protocol used for communication is specified in OR1KSIM_RSP_PROTOCOL.
+//! The service is either a TCP port number, or the path of a Unix domain
+//! socket for use when GDB is on the same host.
 
 //! @return  TRUE if the connection was established or can be retried. FALSE
 //!          if the error was so serious the program must be aborted.
 bool RspConnection::rspConnect() {
-  // Open a socket on which we'll listen for clients
+  // Open a socket on which we'll listen for clients, if we don't have one
+  if (-1 == listenFd) {
+    listenFd = socketPath.empty() ? listenTcp() : listenUnix();
+    if (listenFd < 0)
+      return false;
+  }
+
+  // Accept a client which connects
+  struct sockaddr_storage sockAddr;
+  socklen_t len = sizeof(sockAddr); // Size of the socket address
+  clientFd = accept(listenFd, (struct sockaddr *)&sockAddr, &len);
+
+  if (-1 == clientFd) {
+    cerr << "Warning: Failed to accept RSP client: " << strerror(errno) << endl;
+    return true; // OK to retry
+  }
+
+  if (sockAddr.ss_family == PF_INET) {
+    // Enable TCP keep alive process
+    int optval = 1;
+    setsockopt(clientFd, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval,
+               sizeof(optval));
+
+    // Don't delay small packets, for better interactive response (disable
+    // Nagel's algorithm)
+    optval = 1;
+    setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, (char *)&optval,
+               sizeof(optval));
+  }
+
+  signal(SIGPIPE, SIG_IGN); // So we don't exit if client dies
+
+  if (!traceFlags->traceSilent()) {
+    if (sockAddr.ss_family == PF_INET)
+      cout << "Remote debugging from host "
+           << inet_ntoa(((struct sockaddr_in *)&sockAddr)->sin_addr) << endl;
+    else
+      cout << "Remote debugging on socket " << socketPath << endl;
+  }
+
+  // Nothing from an earlier client carries over to this one
+  resetClientState();
+
+  return true;
+}
+
+//! Open a TCP socket listening on our port
+
+//! If port 0 was specified, the port assigned is recorded, and if requested
+//! written to a file.
+
+//! @return  The listening socket, or -1 on failure.
+int RspConnection::listenTcp() {
   int tmpFd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
   if (tmpFd < 0) {
     cerr << "ERROR: Cannot open RSP socket" << endl;
-    return false;
+    return -1;
   }
 
   // Allow rapid reuse of the port on this socket
@@ -95,13 +163,15 @@ bool RspConnection::rspConnect() {
 
   if (bind(tmpFd, (struct sockaddr *)&sockAddr, sizeof(sockAddr))) {
     cerr << "ERROR: Cannot bind to RSP socket" << endl;
-    return false;
+    close(tmpFd);
+    return -1;
   }
 
   // Listen for (at most one) client
   if (listen(tmpFd, 1)) {
     cerr << "ERROR: Cannot listen on RSP socket" << endl;
-    return false;
+    close(tmpFd);
+    return -1;
   }
 
   // If port 0 specified, determine which port we were assigned
@@ -121,38 +191,67 @@ bool RspConnection::rspConnect() {
     fs << portNum << endl;
     fs.close();
   }
-  // Accept a client which connects
-  socklen_t len = sizeof(sockAddr); // Size of the socket address
-  clientFd = accept(tmpFd, (struct sockaddr *)&sockAddr, &len);
 
-  if (-1 == clientFd) {
-    cerr << "Warning: Failed to accept RSP client: " << strerror(errno) << endl;
-    return true; // OK to retry
+  return tmpFd;
+}
+
+//! Open a Unix domain socket listening on our socket path
+
+//! Any stale socket left at the path by an earlier run is removed first,
+//! but nothing else at the path is touched. The socket appearing in the file
+//! system signals that we are ready.
+
+//! @return  The listening socket, or -1 on failure.
+int RspConnection::listenUnix() {
+  struct sockaddr_un sockAddr;
+
+  if (socketPath.size() >= sizeof(sockAddr.sun_path)) {
+    cerr << "ERROR: RSP socket path too long: " << socketPath << endl;
+    return -1;
   }
 
-  // Enable TCP keep alive process
-  optval = 1;
-  setsockopt(clientFd, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval,
-             sizeof(optval));
+  int tmpFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (tmpFd < 0) {
+    cerr << "ERROR: Cannot open RSP socket" << endl;
+    return -1;
+  }
 
-  // Don't delay small packets, for better interactive response (disable
-  // Nagel's algorithm)
-  optval = 1;
-  setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, (char *)&optval,
-             sizeof(optval));
+  memset(&sockAddr, 0, sizeof(sockAddr));
+  sockAddr.sun_family = AF_UNIX;
+  strncpy(sockAddr.sun_path, socketPath.c_str(), sizeof(sockAddr.sun_path) - 1);
 
-  // Socket is no longer needed
-  close(tmpFd);             // No longer need this
-  signal(SIGPIPE, SIG_IGN); // So we don't exit if client dies
+  struct stat st;
+  if (0 == lstat(socketPath.c_str(), &st)) {
+    if (!S_ISSOCK(st.st_mode)) {
+      cerr << "ERROR: Cannot use RSP socket " << socketPath
+           << ": not a socket" << endl;
+      close(tmpFd);
+      return -1;
+    }
 
-  if (!traceFlags->traceSilent())
-    cout << "Remote debugging from host " << inet_ntoa(sockAddr.sin_addr)
-         << endl;
+    unlink(socketPath.c_str());
+  }
+
+  if (bind(tmpFd, (struct sockaddr *)&sockAddr, sizeof(sockAddr))) {
+    cerr << "ERROR: Cannot bind to RSP socket " << socketPath << ": "
+         << strerror(errno) << endl;
+    close(tmpFd);
+    return -1;
+  }
 
-  // Reset the initial connection state
-  setNoAckMode(false);
+  socketBound = true;
 
-  return true;
+  // Listen for (at most one) client
+  if (listen(tmpFd, 1)) {
+    cerr << "ERROR: Cannot listen on RSP socket" << endl;
+    close(tmpFd);
+    return -1;
+  }
+
+  if (!traceFlags->traceSilent())
+    cout << "Listening for RSP on socket " << socketPath << endl << flush;
+
+  return tmpFd;
 }
 
 //! Close a client connection if it is open
@@ -163,6 +262,7 @@ void RspConnection::rspClose() {
 
     close(clientFd);
     clientFd = -1;
+    resetClientState();
   }
 }
 
@@ -171,6 +271,11 @@ void RspConnection::rspClose() {
 //! @return  TRUE if we are connected, FALSE otherwise
 bool RspConnection::isConnected() { return -1 != clientFd; }
 
+//! Get the client file descriptor, for use in an event loop.
+
+//! @return  The client file descriptor, or -1 if we are not connected
+int RspConnection::getFd() { return clientFd; }
+
 //! Put a single character out on the RSP connection
 
 //! Utility routine. This should only be called if the client is open, but we
@@ -181,16 +286,35 @@ bool RspConnection::isConnected() { return -1 != clientFd; }
 //! @return  TRUE if char sent OK, FALSE if not (communications failure)
 
 bool RspConnection::putRspCharRaw(char c) {
+  return putRspBytesRaw(&c, sizeof(c));
+}
+
+//! Put a buffer of characters out on the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! The kernel may accept only part of the buffer, in which case we carry on
+//! from where it left off.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool RspConnection::putRspBytesRaw(const char *buf, std::size_t len) {
   if (-1 == clientFd) {
-    cerr << "Warning: Attempt to write '" << c
-         << "' to unopened RSP client: Ignored" << endl;
+    cerr << "Warning: Attempt to write " << len
+         << " chars to unopened RSP client: Ignored" << endl;
     return false;
   }
 
-  // Write until successful (we retry after interrupts) or catastrophic
-  // failure.
-  while (true) {
-    switch (write(clientFd, &c, sizeof(c))) {
+  // Write until everything is sent (we retry after interrupts) or
+  // catastrophic failure.
+  while (len > 0) {
+    ssize_t count = write(clientFd, buf, len);
+
+    switch (count) {
     case -1:
       // Error: only allow interrupts or would block
       if ((EAGAIN != errno) && (EINTR != errno)) {
@@ -205,9 +329,13 @@ bool RspConnection::putRspCharRaw(char c) {
       break; // Nothing written! Try again
 
     default:
-      return true; // Success, we can return
+      buf += count; // Partial or complete write
+      len -= static_cast<std::size_t>(count);
+      break;
     }
   }
+
+  return true; // Success, we can return
 }
 
 //! Get a single character from the RSP connection
@@ -220,6 +348,29 @@ bool RspConnection::putRspCharRaw(char c) {
 //!          block, and blocking is true.
 
 int RspConnection::getRspCharRaw(bool blocking) {
+  char c;
+
+  if (1 != getRspBytesRaw(&c, sizeof(c), blocking))
+    return -1;
+
+  return c & 0xff; // Success, we can return (no sign extend!)
+}
+
+//! Get as many characters as are available from the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! A single recv call returns whatever the kernel has ready, up to the size
+//! of the buffer, so a whole packet will usually arrive in one go.
+
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters received or -1 on failure, or if the
+//!          read would block, and blocking is false.
+
+int RspConnection::getRspBytesRaw(char *buf, std::size_t len, bool blocking) {
   if (-1 == clientFd) {
     cerr << "Warning: Attempt to read from "
          << "unopened RSP client: Ignored" << endl;
@@ -230,9 +381,9 @@ int RspConnection::getRspCharRaw(bool blocking) {
   // catastrophic failure.
 
   for (;;) {
-    unsigned char c;
+    ssize_t count = recv(clientFd, buf, len, (blocking ? 0 : MSG_DONTWAIT));
 
-    switch (recv(clientFd, &c, sizeof(c), (blocking ? 0 : MSG_DONTWAIT))) {
+    switch (count) {
     case -1:
       if (!blocking && (errno == EAGAIN || errno == EWOULDBLOCK))
         return -1;
@@ -250,7 +401,7 @@ int RspConnection::getRspCharRaw(bool blocking) {
       return -1;
 
     default:
-      return c & 0xff; // Success, we can return (no sign extend!)
+      return static_cast<int>(count); // Success, we can return
     }
   }
 }
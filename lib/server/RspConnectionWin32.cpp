@@ -42,8 +42,28 @@ using namespace EmbDebug;
 //! @param[in] _traceFlags  flags controlling tracing
 RspConnection::RspConnection(int _portNum, TraceFlags *_traceFlags,
                              bool _writePort)
-    : AbstractConnection(_traceFlags), portNum(_portNum),
-      clientSock(INVALID_SOCKET), writePort(_writePort) {
+    : AbstractConnection(_traceFlags), portNum(_portNum), socketPath(),
+      listenSock(INVALID_SOCKET), clientSock(INVALID_SOCKET),
+      writePort(_writePort) {
+  // Initialize Winsock 2.2.
+  WSAData wsaData;
+  if (int error = WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+    cerr << "Warning: WSAStartup failed with error " << error << "." << endl;
+  }
+}
+
+//! Constructor when using a Unix domain socket
+
+//! Unix domain sockets are not supported on Windows, so any attempt to
+//! connect will fail.
+
+//! @param[in] _socketPath  the path of the socket to listen on
+//! @param[in] _traceFlags  flags controlling tracing
+RspConnection::RspConnection(const std::string &_socketPath,
+                             TraceFlags *_traceFlags)
+    : AbstractConnection(_traceFlags), portNum(0), socketPath(_socketPath),
+      listenSock(INVALID_SOCKET), clientSock(INVALID_SOCKET),
+      writePort(false) {
   // Initialize Winsock 2.2.
   WSAData wsaData;
   if (int error = WSAStartup(MAKEWORD(2, 2), &wsaData)) {
@@ -53,9 +73,12 @@ RspConnection::RspConnection(int _portNum, TraceFlags *_traceFlags,
 
 //! Destructor
 
-//! Close the connection if it is still open
+//! Close the connection if it is still open, and stop listening
 RspConnection::~RspConnection() {
   this->rspClose(); // Don't confuse with any other close ()
+
+  if (INVALID_SOCKET != listenSock)
+    closesocket(listenSock);
   WSACleanup();
 }
 
@@ -67,7 +90,8 @@ RspConnection::~RspConnection() {
 
 //! This involves setting up a socket to listen on a socket for attempted
 //! connections from a single GDB instance (we couldn't be talking to multiple
-//! GDBs at once!).
+//! GDBs at once!). The listening socket is only set up the first time, and
+//! then kept for later connections.
 
 //! The service is specified either as a port number in the Or1ksim
 //! configuration (parameter rsp_port in section debug, default 51000) or as a
@@ -81,55 +105,68 @@ RspConnection::~RspConnection() {
 //! @return  TRUE if the connection was established or can be retried. FALSE
 //!          if the error was so serious the program must be aborted.
 bool RspConnection::rspConnect() {
-  // Open a socket on which we'll listen for clients
-  SOCKET tmpSock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (tmpSock == INVALID_SOCKET) {
-    cerr << "ERROR: Cannot open RSP socket" << endl;
+  if (!socketPath.empty()) {
+    cerr << "ERROR: Unix domain sockets are not supported on this host" << endl;
     return false;
   }
 
-  // Allow rapid reuse of the port on this socket
-  int optval = 1;
-  setsockopt(tmpSock, SOL_SOCKET, SO_REUSEADDR, (char *)&optval,
-             sizeof(optval));
-
-  // Bind the port to the socket
-  struct sockaddr_in sockAddr;
-  sockAddr.sin_family = PF_INET;
-  sockAddr.sin_port = htons(portNum);
-  sockAddr.sin_addr.s_addr = INADDR_ANY;
+  // Open a socket on which we'll listen for clients, if we don't have one
+  if (INVALID_SOCKET == listenSock) {
+    SOCKET tmpSock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (tmpSock == INVALID_SOCKET) {
+      cerr << "ERROR: Cannot open RSP socket" << endl;
+      return false;
+    }
 
-  if (bind(tmpSock, (struct sockaddr *)&sockAddr, sizeof(sockAddr))) {
-    cerr << "ERROR: Cannot bind to RSP socket" << endl;
-    return false;
-  }
+    // Allow rapid reuse of the port on this socket
+    int optval = 1;
+    setsockopt(tmpSock, SOL_SOCKET, SO_REUSEADDR, (char *)&optval,
+               sizeof(optval));
+
+    // Bind the port to the socket
+    struct sockaddr_in sockAddr;
+    sockAddr.sin_family = PF_INET;
+    sockAddr.sin_port = htons(portNum);
+    sockAddr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(tmpSock, (struct sockaddr *)&sockAddr, sizeof(sockAddr))) {
+      cerr << "ERROR: Cannot bind to RSP socket" << endl;
+      closesocket(tmpSock);
+      return false;
+    }
 
-  // Listen for (at most one) client
-  if (listen(tmpSock, 1)) {
-    cerr << "ERROR: Cannot listen on RSP socket" << endl;
-    return false;
-  }
+    // Listen for (at most one) client
+    if (listen(tmpSock, 1)) {
+      cerr << "ERROR: Cannot listen on RSP socket" << endl;
+      closesocket(tmpSock);
+      return false;
+    }
 
-  // If port 0 specified, determine which port we were assigned
-  if (portNum == 0) {
-    socklen_t len = sizeof(sockAddr);
-    getsockname(tmpSock, (struct sockaddr *)&sockAddr, &len);
-    portNum = ntohs(sockAddr.sin_port);
-  }
+    // If port 0 specified, determine which port we were assigned
+    if (portNum == 0) {
+      socklen_t len = sizeof(sockAddr);
+      getsockname(tmpSock, (struct sockaddr *)&sockAddr, &len);
+      portNum = ntohs(sockAddr.sin_port);
+    }
 
-  if (!traceFlags->traceSilent())
-    cout << "Listening for RSP on port " << portNum << endl << flush;
+    if (!traceFlags->traceSilent())
+      cout << "Listening for RSP on port " << portNum << endl << flush;
+
+    if (writePort) {
+      // Generate a file to signal that the Gdbserver side is ready
+      std::ofstream fs;
+      fs.open("simulation_ready.txt");
+      fs << portNum << endl;
+      fs.close();
+    }
 
-  if (writePort) {
-    // Generate a file to signal that the Gdbserver side is ready
-    std::ofstream fs;
-    fs.open("simulation_ready.txt");
-    fs << portNum << endl;
-    fs.close();
+    listenSock = tmpSock;
   }
+
   // Accept a client which connects
+  struct sockaddr_in sockAddr;
   socklen_t len = sizeof(sockAddr); // Size of the socket address
-  clientSock = accept(tmpSock, (struct sockaddr *)&sockAddr, &len);
+  clientSock = accept(listenSock, (struct sockaddr *)&sockAddr, &len);
 
   if (!isConnected()) {
     cerr << "Warning: Failed to accept RSP client: " << WSAGetLastError()
@@ -138,7 +175,7 @@ bool RspConnection::rspConnect() {
   }
 
   // Enable TCP keep alive process
-  optval = 1;
+  int optval = 1;
   setsockopt(clientSock, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval,
              sizeof(optval));
 
@@ -148,9 +185,6 @@ bool RspConnection::rspConnect() {
   setsockopt(clientSock, IPPROTO_TCP, TCP_NODELAY, (char *)&optval,
              sizeof(optval));
 
-  // Socket is no longer needed
-  closesocket(tmpSock); // No longer need this
-
   if (!traceFlags->traceSilent()) {
     char str[INET_ADDRSTRLEN];
     cout << "Remote debugging from host "
@@ -158,8 +192,8 @@ bool RspConnection::rspConnect() {
          << endl;
   }
 
-  // Reset the initial connection state
-  setNoAckMode(false);
+  // Nothing from an earlier client carries over to this one
+  resetClientState();
 
   return true;
 }
@@ -176,6 +210,7 @@ void RspConnection::rspClose() {
 
     closesocket(clientSock);
     clientSock = INVALID_SOCKET;
+    resetClientState();
   }
 }
 
@@ -184,6 +219,13 @@ void RspConnection::rspClose() {
 //! @return  TRUE if we are connected, FALSE otherwise
 bool RspConnection::isConnected() { return INVALID_SOCKET != clientSock; }
 
+//! Get the client file descriptor, for use in an event loop.
+
+//! Winsock sockets can't be used by the event loop, so we never provide one.
+
+//! @return  Always -1
+int RspConnection::getFd() { return -1; }
+
 //! Put a single character out on the RSP connection
 
 //! Utility routine. This should only be called if the client is open, but we
@@ -194,19 +236,41 @@ bool RspConnection::isConnected() { return INVALID_SOCKET != clientSock; }
 //! @return  TRUE if char sent OK, FALSE if not (communications failure)
 
 bool RspConnection::putRspCharRaw(char c) {
+  return putRspBytesRaw(&c, sizeof(c));
+}
+
+//! Put a buffer of characters out on the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool RspConnection::putRspBytesRaw(const char *buf, std::size_t len) {
   if (clientSock == INVALID_SOCKET) {
-    cerr << "Warning: Attempt to write '" << c
-         << "' to unopened RSP client: Ignored" << endl;
+    cerr << "Warning: Attempt to write " << len
+         << " chars to unopened RSP client: Ignored" << endl;
     return false;
   }
 
-  // Attempt to write to the socket
-  if (send(clientSock, &c, sizeof(c), 0) == SOCKET_ERROR) {
-    cerr << "Warning: Failed to write to RSP Client: "
-         << "Closing client connection: " << WSAGetLastError() << endl;
-    rspClose();
-    return false;
+  // Attempt to write to the socket, carrying on after partial writes
+  while (len > 0) {
+    int count = send(clientSock, buf, static_cast<int>(len), 0);
+
+    if (count == SOCKET_ERROR) {
+      cerr << "Warning: Failed to write to RSP Client: "
+           << "Closing client connection: " << WSAGetLastError() << endl;
+      rspClose();
+      return false;
+    }
+
+    buf += count;
+    len -= static_cast<std::size_t>(count);
   }
+
   return true;
 }
 
@@ -220,6 +284,26 @@ bool RspConnection::putRspCharRaw(char c) {
 //!          block, and blocking is true.
 
 int RspConnection::getRspCharRaw(bool blocking) {
+  char c;
+
+  if (1 != getRspBytesRaw(&c, sizeof(c), blocking))
+    return -1;
+
+  return c & 0xff; // Success, we can return (no sign extend!)
+}
+
+//! Get as many characters as are available from the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters received or -1 on failure, or if the
+//!          read would block, and blocking is false.
+
+int RspConnection::getRspBytesRaw(char *buf, std::size_t len, bool blocking) {
   if (!isConnected()) {
     cerr << "Warning: Attempt to read from "
          << "unopened RSP client: Ignored" << endl;
@@ -231,26 +315,22 @@ int RspConnection::getRspCharRaw(bool blocking) {
   if (ioctlsocket(clientSock, FIONBIO, &blockingMode))
     cerr << "Warning: Unable to set blocking mode of socket." << endl;
 
-  // Blocking read until successful (we retry after interrupts) or
-  // catastrophic failure.
-
-  while (true) {
-    char c;
-    switch (recv(clientSock, &c, sizeof(c), 0)) {
-    case SOCKET_ERROR:
-      // If non-blocking and no data, return -1
-      if (!blocking && WSAGetLastError() == WSAEWOULDBLOCK)
-        return -1;
+  int count = recv(clientSock, buf, static_cast<int>(len), 0);
 
-      cerr << "Warning: Failed to read from RSP client: " << WSAGetLastError()
-           << endl;
+  switch (count) {
+  case SOCKET_ERROR:
+    // If non-blocking and no data, return -1
+    if (!blocking && WSAGetLastError() == WSAEWOULDBLOCK)
       return -1;
 
-    case 0:
-      return -1;
+    cerr << "Warning: Failed to read from RSP client: " << WSAGetLastError()
+         << endl;
+    return -1;
 
-    default:
-      return c & 0xff; // Success, we can return (no sign extend!)
-    }
+  case 0:
+    return -1;
+
+  default:
+    return count; // Success, we can return
   }
 }
@@ -7,11 +7,13 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // ----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 #include "RspPacket.h"
 #include "Utils.h"
@@ -29,39 +31,209 @@ using namespace EmbDebug;
 // Define the bufSize with its default value
 std::size_t RspPacket::bufSize = 10000;
 
+namespace {
+
+//! Pool of free packet buffers
+
+//! Buffers are sized in powers of 2, with a free list for each size. Each
+//! thread has its own pool, so that sessions on different threads need no
+//! locking. A buffer freed on a thread other than the one which allocated it
+//! simply joins that thread's pool.
+
+class BufferPool {
+public:
+  ~BufferPool() {
+    for (auto &freeList : mFree)
+      for (char *buf : freeList)
+        delete[] buf;
+  }
+
+  //! Get a buffer of at least the given size
+
+  //! @param[in]  size  The size needed
+  //! @param[out] cap   The size of the buffer returned
+  //! @return  The buffer
+  char *alloc(std::size_t size, std::size_t &cap) {
+    std::size_t sizeClass = classOf(size);
+    cap = static_cast<std::size_t>(1) << (sizeClass + MIN_SHIFT);
+
+    if ((sizeClass < NUM_CLASSES) && !mFree[sizeClass].empty()) {
+      char *buf = mFree[sizeClass].back();
+      mFree[sizeClass].pop_back();
+      return buf;
+    }
+
+    return new char[cap];
+  }
+
+  //! Give a buffer back
+
+  //! @param[in] buf  The buffer, which may be nullptr
+  //! @param[in] cap  The size of the buffer, as returned by alloc
+  void free(char *buf, std::size_t cap) {
+    if (buf == nullptr)
+      return;
+
+    std::size_t sizeClass = classOf(cap);
+
+    if ((sizeClass < NUM_CLASSES) && (mFree[sizeClass].size() < MAX_FREE))
+      mFree[sizeClass].push_back(buf);
+    else
+      delete[] buf;
+  }
+
+private:
+  //! The smallest buffer handed out is 2^MIN_SHIFT bytes
+
+  static const std::size_t MIN_SHIFT = 6;
+
+  //! Number of buffer sizes pooled. Bigger buffers are just freed.
+
+  static const std::size_t NUM_CLASSES = 20;
+
+  //! Most free buffers of each size kept
+
+  static const std::size_t MAX_FREE = 8;
+
+  //! The free lists, one for each size
+
+  std::vector<char *> mFree[NUM_CLASSES];
+
+  //! The smallest size class big enough for a size
+
+  static std::size_t classOf(std::size_t size) {
+    std::size_t sizeClass = 0;
+
+    while ((static_cast<std::size_t>(1) << (sizeClass + MIN_SHIFT)) < size)
+      sizeClass++;
+
+    return sizeClass;
+  }
+};
+
+thread_local BufferPool bufferPool;
+
+} // namespace
+
+//! Create one of the common constant replies, referring to a string
+//! constant, so that it needs no storage of its own.
+static RspPacket constReply(const char *str) {
+  return RspPacket::CreateView(const_cast<char *>(str), ::strlen(str));
+}
+
+const RspPacket RspPacket::OK = constReply("OK");
+const RspPacket RspPacket::EMPTY = constReply("");
+const RspPacket RspPacket::E00 = constReply("E00");
+const RspPacket RspPacket::E01 = constReply("E01");
+const RspPacket RspPacket::E02 = constReply("E02");
+const RspPacket RspPacket::E04 = constReply("E04");
+
 //! Default constructor
-RspPacket::RspPacket() : len(0) {
-  data = new char[bufSize];
-  ::memset(data, 0, bufSize);
+
+//! No buffer is allocated until there is data to go in it.
+RspPacket::RspPacket() : len(0) {}
+
+//! Constructor from a char buffer
+
+//! @param[in] X     The data
+//! @param[in] _len  The number of chars of data
+RspPacket::RspPacket(const char *X, std::size_t _len) {
+  allocate(_len);
+  ::memcpy(data, X, _len);
+  len = _len;
+  data[len] = 0;
+}
+
+//! Create a packet referring to data held elsewhere
+
+//! Nothing is copied. The data must be followed by a zero byte, and must
+//! stay valid for as long as the packet (or anything moved from it) is in
+//! use. Copies of the packet have their own data.
+
+//! @param[in] X     The data
+//! @param[in] _len  The number of chars of data
+RspPacket RspPacket::CreateView(char *X, std::size_t _len) {
+  RspPacket view;
+  view.data = X;
+  view.len = _len;
+  return view;
 }
 
 //! Copy constructor
+
+//! Only the data is copied, not the whole buffer.
 RspPacket::RspPacket(const RspPacket &other) {
-  data = new char[bufSize];
-  ::memcpy(data, other.data, bufSize);
+  if (other.data == nullptr)
+    return;
+
+  allocate(other.len);
+  ::memcpy(data, other.data, other.len + 1);
   len = other.len;
 }
 
 //! Move constructor
-RspPacket::RspPacket(RspPacket &&other) {
-  data = std::move(other.data);
-  len = other.len;
-  other.data = nullptr;
-  other.len = 0;
-}
+RspPacket::RspPacket(RspPacket &&other) { take(other); }
 
 //! Constructor from a builder
 RspPacket::RspPacket(const RspPacketBuilder &builder) {
-  data = new char[bufSize];
-  ::memcpy(data, builder.data, bufSize);
+  allocate(builder.len);
+  if (builder.len > 0)
+    ::memcpy(data, builder.data, builder.len);
   len = builder.len;
+  data[len] = 0;
 }
 
 //! Destructor
-RspPacket::~RspPacket() {
-  if (data != nullptr)
-    delete[] data;
+
+//! Any buffer goes back in the pool.
+RspPacket::~RspPacket() { release(); }
+
+//! Get storage for a given length of data, plus the trailing zero byte.
+
+//! Short packets use the storage within the packet. Otherwise a buffer is
+//! taken from the pool. Any buffer already held goes back to the pool. The
+//! storage is not cleared.
+
+//! @param[in] _len  The length of data to be held
+void RspPacket::allocate(std::size_t _len) {
+  release();
+
+  if (_len < INLINE_SIZE)
+    data = inlineData;
+  else
+    data = bufferPool.alloc(_len + 1, cap);
+
+  len = 0;
+}
+
+//! Give any buffer held back to the pool, leaving an empty packet.
+void RspPacket::release() {
+  if (cap > 0)
+    bufferPool.free(data, cap);
+
   data = nullptr;
+  len = 0;
+  cap = 0;
+}
+
+//! Take over the data of another packet, leaving it empty.
+
+//! Buffers and views are passed over as they are. Data held inline has to be
+//! copied.
+
+//! @param[in] other  The packet to take the data of
+void RspPacket::take(RspPacket &other) {
+  if (other.data == other.inlineData) {
+    ::memcpy(inlineData, other.inlineData, other.len + 1);
+    data = inlineData;
+  } else
+    data = other.data;
+
+  len = other.len;
+  cap = other.cap;
+  other.data = nullptr;
+  other.len = 0;
+  other.cap = 0;
 }
 
 //! Create a new packet from a const string as a hex encoded string for qRcmd.
@@ -83,6 +255,7 @@ RspPacket RspPacket::CreateHexStr(const char *str) {
   }
 
   // Construct the string the hard way
+  response.allocate(slen * 2 + 1);
   response.data[0] = 'O';
   for (std::size_t i = 0; i < slen; i++) {
     int nybble_hi = str[i] >> 4;
@@ -120,6 +293,7 @@ RspPacket RspPacket::CreateRcmdStr(const char *str, const bool toStdoutP) {
   }
 
   // Construct the string the hard way
+  response.allocate(slen * 2 + 1);
   int offset;
   if (toStdoutP) {
     response.data[0] = 'O';
@@ -145,40 +319,49 @@ RspPacket RspPacket::CreateRcmdStr(const char *str, const bool toStdoutP) {
 
 // Move operator
 RspPacket &RspPacket::operator=(RspPacket &&other) {
-  if (data != nullptr)
-    delete[] data;
-  data = std::move(other.data);
-  len = other.len;
-  other.data = nullptr;
-  other.len = 0;
+  if (this == &other)
+    return *this;
+
+  release();
+  take(other);
   return *this;
 }
 
-//! Create a packet from a printf-style call
-
-//! @return a packet with the printf-formatted string
-RspPacket RspPacket::CreateFormatted(const char *format, ...) {
-  RspPacket response;
-  va_list args;
-  va_start(args, format);
-  response.len = vsnprintf(response.data, 10000, format, args);
-  va_end(args);
-  return response;
-}
+//! Default constructor
 
-//! Default constructor to allocate data buffer
-RspPacketBuilder::RspPacketBuilder() {
-  data = new char[RspPacket::getMaxPacketSize()];
-  ::memset(data, 0, RspPacket::getMaxPacketSize());
-}
+//! No buffer is allocated until data is added.
+RspPacketBuilder::RspPacketBuilder() : data(inlineData), cap(INLINE_SIZE) {}
 
-//! Default constructor to free data buffer
+//! Destructor, to give back the data buffer
 RspPacketBuilder::~RspPacketBuilder() {
-  if (data != nullptr)
-    delete[] data;
+  if (data != inlineData)
+    bufferPool.free(data, cap);
   data = nullptr;
 }
 
+//! Grow the data buffer to hold a given length of data
+
+//! The buffer at least doubles each time it grows, and only the data held is
+//! copied to the new buffer. Callers which know how much data they will add
+//! may reserve it up front.
+
+//! @param[in] _len  The length of data to be held
+void RspPacketBuilder::reserve(std::size_t _len) {
+  if (_len <= cap)
+    return;
+
+  std::size_t newCap;
+  char *newData = bufferPool.alloc(std::max(_len, cap * 2), newCap);
+
+  if (len > 0)
+    ::memcpy(newData, data, len);
+
+  if (data != inlineData)
+    bufferPool.free(data, cap);
+  data = newData;
+  cap = newCap;
+}
+
 //! Add a C string to the current packet
 RspPacketBuilder &RspPacketBuilder::operator+=(const char *str) {
   std::size_t _len = ::strlen(str);
@@ -193,6 +376,7 @@ RspPacketBuilder &RspPacketBuilder::operator+=(const char c) {
               << EMBDEBUG_PRETTY_FUNCTION << std::endl;
     return *this;
   }
+  reserve(len + 1);
   data[len] = c;
   len++;
   return *this;
@@ -211,10 +395,90 @@ void RspPacketBuilder::addData(const char *str, std::size_t _len) {
               << EMBDEBUG_PRETTY_FUNCTION << std::endl;
     return;
   }
+  reserve(len + _len);
   ::memcpy(&data[len], str, _len);
   len += _len;
 }
 
+//! Add room for a given length of data at the end of the packet
+
+//! This lets bulk conversions write straight into the packet.
+
+//! @param[in] _len  The length of data to be added
+//! @return  Where the caller should write the data, or nullptr if the
+//!          packet would be too long.
+char *RspPacketBuilder::addSpace(std::size_t _len) {
+  if ((len + _len) > RspPacket::getMaxPacketSize()) {
+    std::cerr << "Warning: RspPacketBuilder length exceeded, ignoring "
+              << EMBDEBUG_PRETTY_FUNCTION << std::endl;
+    return nullptr;
+  }
+  reserve(len + _len);
+  char *space = &data[len];
+  len += _len;
+  return space;
+}
+
+//! Add a number as hex digits
+
+//! Digits are lower case, with no leading zeros unless a width is given.
+
+//! @param[in] val    The number
+//! @param[in] width  The least number of digits, padded with leading zeros
+//! @return  The builder, so emitters can be chained
+RspPacketBuilder &RspPacketBuilder::addHex(uint64_t val, unsigned int width) {
+  char digits[16];
+  unsigned int n = 0;
+
+  do {
+    digits[n++] = Utils::hex2Char(val & 0xf);
+    val >>= 4;
+  } while (val != 0);
+
+  while (width > n) {
+    *this += '0';
+    width--;
+  }
+
+  while (n > 0)
+    *this += digits[--n];
+
+  return *this;
+}
+
+//! Add a number as decimal digits
+
+//! @param[in] val  The number
+//! @return  The builder, so emitters can be chained
+RspPacketBuilder &RspPacketBuilder::addDec(uint64_t val) {
+  char digits[20];
+  unsigned int n = 0;
+
+  do {
+    digits[n++] = static_cast<char>('0' + (val % 10));
+    val /= 10;
+  } while (val != 0);
+
+  while (n > 0)
+    *this += digits[--n];
+
+  return *this;
+}
+
+//! Add text encoded as pairs of hex digits, as used for console output
+
+//! @param[in] view  The text
+//! @return  The builder, so emitters can be chained
+RspPacketBuilder &RspPacketBuilder::addHexStr(const ByteView view) {
+  for (std::size_t i = 0; i < view.getLen(); i++) {
+    unsigned char c = static_cast<unsigned char>(view[i]);
+    *this += Utils::hex2Char(c >> 4);
+    *this += Utils::hex2Char(c & 0xf);
+  }
+
+  return *this;
+}
+
 namespace EmbDebug {
 
 //! Output stream operator
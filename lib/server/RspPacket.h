@@ -10,8 +10,8 @@
 #define RSP_PACKET_H
 
 #include <cassert>
-#include <cstdarg>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 #include "embdebug/ByteView.h"
@@ -23,7 +23,14 @@ class RspPacketBuilder;
 
 //! Class for RSP packets
 
-//! Can't be null terminated, since it may include zero bytes
+//! Can't be null terminated, since it may include zero bytes. However a zero
+//! byte is always kept after the data, so packets known to be text may be
+//! used as C strings.
+
+//! Short packets, which are most replies, are held in the packet itself.
+//! Longer packets have buffers only as big as the data they hold, which come
+//! from a pool of free buffers, so that packets are cheap even when the
+//! maximum packet size is large.
 class RspPacket {
 public:
   //! The data buffer. Allow direct access to avoid unnecessary copying.
@@ -39,23 +46,13 @@ public:
   RspPacket &operator=(RspPacket &&other);
 
   //! Create packet from constant string
-  RspPacket(const char *X) {
-    data = new char[bufSize];
-    ::memset(data, 0, bufSize);
-    len = ::strlen(X);
-    ::memcpy(data, X, len);
-  }
+  RspPacket(const char *X) : RspPacket(X, ::strlen(X)) {}
 
   //! Create packet from constant char buffer
-  RspPacket(const char *X, std::size_t _len) {
-    data = new char[bufSize];
-    ::memset(data, 0, bufSize);
-    len = _len;
-    ::memcpy(data, X, len);
-  }
+  RspPacket(const char *X, std::size_t _len);
 
-  //! Create packet from printf-style call
-  static RspPacket CreateFormatted(const char *format, ...);
+  //! Create packet referring to data held elsewhere
+  static RspPacket CreateView(char *X, std::size_t _len);
 
   //! Create packet in response to RCmd packet
   static RspPacket CreateRcmdStr(const char *str, const bool toStdoutP);
@@ -63,13 +60,21 @@ public:
   //! Hex-encode packet from string
   static RspPacket CreateHexStr(const char *str);
 
+  // Common constant replies, which need no storage of their own
+  static const RspPacket OK;
+  static const RspPacket EMPTY;
+  static const RspPacket E00;
+  static const RspPacket E01;
+  static const RspPacket E02;
+  static const RspPacket E04;
+
   // Accessors
   static void setMaxPacketSize(std::size_t _bufSize) { bufSize = _bufSize; }
   static std::size_t getMaxPacketSize() { return bufSize; };
   std::size_t getLen() const { return len; };
 
   //! Access data buffer
-  const char *getRawData() const { return data; }
+  const char *getRawData() const { return (data != nullptr) ? data : ""; }
 
   //! Access data buffer via ByteView
   ByteView getData() const { return ByteView(data, len); }
@@ -78,30 +83,65 @@ private:
   //! The data buffer size (the same for all, hence static)
   static std::size_t bufSize;
 
-  //! The data pointer
-  char *data;
+  //! Size of the storage within the packet for short packets, including
+  //! the trailing zero byte
+  static const std::size_t INLINE_SIZE = 32;
+
+  //! The data pointer, or nullptr for an empty packet with no buffer
+  char *data = nullptr;
 
   //! Number of chars in the data buffer (<= bufSize)
   std::size_t len = 0;
+
+  //! Size of the data buffer from the pool, including room for the trailing
+  //! zero byte. Zero if the data is held inline, or not owned by the packet.
+  std::size_t cap = 0;
+
+  //! Storage for short packets
+  char inlineData[INLINE_SIZE];
+
+  // Take a buffer big enough for a given length of data
+  void allocate(std::size_t _len);
+
+  // Give back any buffer held
+  void release();
+
+  // Take over the data of another packet
+  void take(RspPacket &other);
+
+  // Room in the buffer, including the trailing zero byte
+  std::size_t capacity() const {
+    return (data == inlineData) ? INLINE_SIZE : cap;
+  }
 };
 
 //! RspPacket Builder
 
 //! This provides a convenience mechanism for building up valid packets from a
-//! set of chars/c strings/byte arrays
+//! set of chars/c strings/byte arrays, and numbers written straight into the
+//! packet as hex or decimal digits. Short packets are built within the
+//! builder, so replies such as stop packets need no buffer from the pool and
+//! no formatting pass.
 class RspPacketBuilder {
   // RspPacket can see the builders data and length buffers for constructing a
   // packet from the builders current state.
   friend class RspPacket;
 
+  //! Size of the storage within the builder for short packets
+  static const std::size_t INLINE_SIZE = 32;
+
   char *data;
   std::size_t len = 0;
+  std::size_t cap = 0;
+  char inlineData[INLINE_SIZE];
 
 public:
   // Constructor to allocate data array
   RspPacketBuilder();
   RspPacketBuilder(RspPacket &&other) = delete;
   RspPacketBuilder(const RspPacket &other) = delete;
+  RspPacketBuilder(const RspPacketBuilder &other) = delete;
+  RspPacketBuilder &operator=(const RspPacketBuilder &other) = delete;
   ~RspPacketBuilder();
 
   RspPacketBuilder &operator+=(const char *str);
@@ -110,16 +150,27 @@ public:
   void addData(const char *str, std::size_t _len);
   void addData(const ByteView view) { addData(view.getData(), view.getLen()); }
 
+  // Typed emitters
+  RspPacketBuilder &addHex(uint64_t val, unsigned int width = 0);
+  RspPacketBuilder &addDec(uint64_t val);
+  RspPacketBuilder &addHexStr(const ByteView view);
+
+  // Grow the buffer to hold a given length of data
+  void reserve(std::size_t _len);
+
+  // Add room for data, for the caller to fill in
+  char *addSpace(std::size_t _len);
+
   std::size_t getSize() const { return len; }
   std::size_t getRemaining() const {
     return RspPacket::getMaxPacketSize() - len;
   }
   std::size_t getMaxPacketSize() const { return RspPacket::getMaxPacketSize(); }
 
-  void erase() {
-    ::memset(data, 0, RspPacket::getMaxPacketSize());
-    len = 0;
-  }
+  void erase() { len = 0; }
+
+  //! Access the data built so far
+  ByteView getData() const { return ByteView(data, len); }
 };
 
 //! Stream output
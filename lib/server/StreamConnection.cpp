@@ -43,14 +43,24 @@ using std::setw;
 
 using namespace EmbDebug;
 
-//! Constructor when using a port number
+//! Constructor when using standard input and output
 
 //! Sets up various parameters
 
-//! @param[in] _portNum     the port number to connect to
 //! @param[in] _traceFlags  flags controlling tracing
 StreamConnection::StreamConnection(TraceFlags *_traceFlags)
-    : AbstractConnection(_traceFlags), mIsConnected(true) {}
+    : AbstractConnection(_traceFlags), mInFd(STDIN_FILENO),
+      mOutFd(STDOUT_FILENO), mIsConnected(true) {}
+
+//! Constructor when using other streams, such as the ends of pipes
+
+//! @param[in] _traceFlags  flags controlling tracing
+//! @param[in] _inFd        file descriptor to read from the client
+//! @param[in] _outFd       file descriptor to write to the client
+StreamConnection::StreamConnection(TraceFlags *_traceFlags, int _inFd,
+                                   int _outFd)
+    : AbstractConnection(_traceFlags), mInFd(_inFd), mOutFd(_outFd),
+      mIsConnected(true) {}
 
 //! Destructor
 
@@ -94,6 +104,18 @@ void StreamConnection::rspClose() { mIsConnected = false; }
 //! @return  TRUE if we are connected, FALSE otherwise
 bool StreamConnection::isConnected() { return mIsConnected; }
 
+//! Get the input file descriptor, for use in an event loop.
+
+//! @return  The input file descriptor, or -1 if we are not connected or are
+//!          on a host where it can't be waited on.
+int StreamConnection::getFd() {
+#if _WIN32
+  return -1;
+#else
+  return mIsConnected ? mInFd : -1;
+#endif
+}
+
 //! Put a single character out on the RSP connection
 
 //! Utility routine. This should only be called if the client is open, but we
@@ -104,10 +126,44 @@ bool StreamConnection::isConnected() { return mIsConnected; }
 //! @return  TRUE if char sent OK, FALSE if not (communications failure)
 
 bool StreamConnection::putRspCharRaw(char c) {
-  // Write until successful (we retry after interrupts) or catastrophic
-  // failure.
-  while (true) {
-    switch (_write(STDOUT_FILENO, &c, sizeof(c))) {
+  return putRspBytesRaw(&c, sizeof(c));
+}
+
+//! Get a single character from the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! @param[in] blocking  True if the read should block.
+//! @return  The character received or -1 on failure, or if the read would
+//!          block, and blocking is true.
+
+int StreamConnection::getRspCharRaw(bool blocking) {
+  char c;
+
+  if (1 != getRspBytesRaw(&c, sizeof(c), blocking))
+    return -1;
+
+  return c & 0xff; // Success, we can return (no sign extend!)
+}
+
+//! Put a buffer of characters out on the RSP connection
+
+//! The pipe may accept only part of the buffer, in which case we carry on
+//! from where it left off.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool StreamConnection::putRspBytesRaw(const char *buf, std::size_t len) {
+  // Write until everything is sent (we retry after interrupts) or
+  // catastrophic failure.
+  while (len > 0) {
+    ssize_t count = _write(mOutFd, buf, static_cast<unsigned int>(len));
+
+    switch (count) {
     case -1:
       // Error: only allow interrupts or would block
       if ((EAGAIN != errno) && (EINTR != errno)) {
@@ -122,40 +178,38 @@ bool StreamConnection::putRspCharRaw(char c) {
       break; // Nothing written! Try again
 
     default:
-      return true; // Success, we can return
+      buf += count; // Partial or complete write
+      len -= static_cast<std::size_t>(count);
+      break;
     }
   }
+
+  return true; // Success, we can return
 }
 
-//! Get a single character from the RSP connection
+//! Get as many characters as are available from the RSP connection
 
-//! Utility routine. This should only be called if the client is open, but we
-//! check for safety.
+//! A blocking read goes straight to the pipe. A non-blocking read first
+//! checks that there is something to read, so that it can't block.
 
-//! @param[in] blocking  True if the read should block.
-//! @return  The character received or -1 on failure, or if the read would
-//!          block, and blocking is true.
-
-int StreamConnection::getRspCharRaw(bool blocking) {
-  // Blocking read until successful (we retry after interrupts) or
-  // catastrophic failure.
-
-  for (;;) {
-    unsigned char c;
-    int res;
-    struct timeval timeout;
-    fd_set readfds;
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters received or -1 on failure, or if the
+//!          read would block, and blocking is false.
 
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 0;
+int StreamConnection::getRspBytesRaw(char *buf, std::size_t len,
+                                     bool blocking) {
+  if (!blocking && !inputReady())
+    return -1;
 
-    FD_ZERO(&readfds);
-    FD_SET(STDIN_FILENO, &readfds);
+  // Read until successful (we retry after interrupts) or catastrophic
+  // failure.
 
-    res = select(STDIN_FILENO + 1, &readfds, NULL, NULL,
-                 (blocking ? NULL : &timeout));
+  for (;;) {
+    ssize_t count = _read(mInFd, buf, static_cast<unsigned int>(len));
 
-    switch (res) {
+    switch (count) {
     case -1:
       // Error: only allow interrupts
 
@@ -167,20 +221,44 @@ int StreamConnection::getRspCharRaw(bool blocking) {
       break;
 
     case 0:
-      // Timeout, only happens in the blocking case.
-      return -1;
+      return -1; // End of file
 
-    default: {
-      ssize_t count;
+    default:
+      return static_cast<int>(count); // Success, we can return
+    }
+  }
+}
 
-      if ((count = _read(STDIN_FILENO, &c, sizeof(c))) == -1)
-        return -1;
+//! Is there input waiting to be read?
 
-      if (count == 0)
-        return -1;
+//! @return  TRUE if a read would not block (which includes end of file or an
+//!          error), FALSE otherwise.
 
-      return c & 0xff; // Success, we can return (no sign extend!)
-    }
+bool StreamConnection::inputReady() {
+  for (;;) {
+    struct timeval timeout;
+    fd_set readfds;
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+
+    FD_ZERO(&readfds);
+    FD_SET(mInFd, &readfds);
+
+    switch (select(mInFd + 1, &readfds, NULL, NULL, &timeout)) {
+    case -1:
+      // Error: only allow interrupts
+
+      if (EINTR != errno)
+        return true; // Let the read report the error
+
+      break;
+
+    case 0:
+      return false; // Nothing to read
+
+    default:
+      return true;
     }
   }
 }
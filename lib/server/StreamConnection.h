@@ -24,6 +24,7 @@ public:
   // Constructors and destructor
 
   StreamConnection(TraceFlags *_traceFlags);
+  StreamConnection(TraceFlags *_traceFlags, int _inFd, int _outFd);
   ~StreamConnection();
 
   // Public interface: manage client connections
@@ -31,12 +32,22 @@ public:
   virtual bool rspConnect();
   virtual void rspClose();
   virtual bool isConnected();
+  virtual int getFd();
+  virtual bool isReliable() { return true; }
 
 private:
-  // Implementation specific routines to handle individual chars.
+  // Implementation specific routines to handle chars.
 
   virtual bool putRspCharRaw(char c);
   virtual int getRspCharRaw(bool blocking);
+  virtual bool putRspBytesRaw(const char *buf, std::size_t len);
+  virtual int getRspBytesRaw(char *buf, std::size_t len, bool blocking);
+
+  bool inputReady();
+
+  // The streams to and from the client
+  int mInFd;
+  int mOutFd;
 
   // Track whether we are connected or not.
   bool mIsConnected;
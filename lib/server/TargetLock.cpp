@@ -0,0 +1,55 @@
+// Lock serializing target access between sessions: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include "TargetLock.h"
+
+using namespace EmbDebug;
+
+//! Constructor
+
+//! The lock starts off free.
+
+TargetLock::TargetLock() : mNextTicket(0), mServing(0) {}
+
+//! Take the target, waiting for every session which asked before us.
+
+//! Tickets are served strictly in turn, so if a session is served with the
+//! ticket after the one it last held, no other session has held the lock in
+//! between.
+
+//! @return  The ticket we were served with.
+
+unsigned long TargetLock::lock() {
+  std::unique_lock<std::mutex> guard(mMutex);
+  unsigned long ticket = mNextTicket++;
+
+  mCond.wait(guard, [this, ticket] { return mServing == ticket; });
+  return ticket;
+}
+
+//! Hand the target on to the next session waiting for it, if any.
+
+void TargetLock::unlock() {
+  {
+    std::lock_guard<std::mutex> guard(mMutex);
+    mServing++;
+  }
+
+  mCond.notify_all();
+}
+
+//! Is another session waiting for the target?
+
+//! This should only be called by the session holding the lock.
+
+//! @return  TRUE if some other session is waiting, FALSE otherwise.
+
+bool TargetLock::contended() {
+  std::lock_guard<std::mutex> guard(mMutex);
+  return (mNextTicket - mServing) > 1;
+}
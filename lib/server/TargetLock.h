@@ -0,0 +1,64 @@
+// Lock serializing target access between sessions: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef TARGET_LOCK_H
+#define TARGET_LOCK_H
+
+#include <condition_variable>
+#include <mutex>
+
+namespace EmbDebug {
+
+//! Class to share one target between several GDB sessions.
+
+//! Only the session holding the lock may call into the target. Waiting
+//! sessions are served strictly in turn, so a session whose cores are
+//! running can check whether it is holding anyone up, and hand the target
+//! over by unlocking and locking again.
+
+class TargetLock {
+public:
+  // Constructor
+
+  TargetLock();
+
+  // Take and release the target
+
+  unsigned long lock();
+  void unlock();
+
+  // Is another session waiting for the target?
+
+  bool contended();
+
+private:
+  // Don't allow copying
+
+  TargetLock(const TargetLock &) = delete;
+  TargetLock &operator=(const TargetLock &) = delete;
+
+  //! Protects the ticket counters
+
+  std::mutex mMutex;
+
+  //! Signalled when the lock is handed on
+
+  std::condition_variable mCond;
+
+  //! The ticket the next session to ask for the lock will get
+
+  unsigned long mNextTicket;
+
+  //! The ticket of the session which may hold the lock
+
+  unsigned long mServing;
+};
+
+} // namespace EmbDebug
+
+#endif
@@ -138,3 +138,33 @@ bool Timeout::timedOut(ITarget *cpu) const {
     abort();
   }
 }
+
+//! How long may we wait for events before checking for a timeout?
+
+//! For a wall clock timeout this is the time remaining. A cycle count
+//! timeout can only be checked by asking the target, so we must check
+//! regularly.
+
+//! @return  The time in milliseconds, or -1 if we may wait for ever.
+
+int Timeout::pollInterval() const {
+  switch (mTimeoutType) {
+  case Type::NONE:
+    return -1;
+
+  case Type::REAL: {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        (mRealStamp + mRealTimeout) - std::chrono::system_clock::now());
+    return remaining.count() > 0 ? static_cast<int>(remaining.count()) : 0;
+  }
+
+  case Type::CYCLE:
+    return CYCLE_POLL_INTERVAL;
+
+  default:
+
+    std::cerr << "*** ABORT: Impossible clock type in pollInterval"
+              << std::endl;
+    abort();
+  }
+}
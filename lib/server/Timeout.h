@@ -52,8 +52,14 @@ public:
 
   void timeStamp(ITarget *cpu);
   bool timedOut(ITarget *cpu) const;
+  int pollInterval() const;
 
 private:
+  //! How often (in milliseconds) to check a cycle count timeout when
+  //! waiting for events.
+
+  static const int CYCLE_POLL_INTERVAL = 10;
+
   //! An enumeration for the timeout type.
 
   enum class Type {
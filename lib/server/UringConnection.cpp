@@ -0,0 +1,546 @@
+// Remote Serial Protocol connection using io_uring: implementation
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <iostream>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef EMBDEBUG_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "TraceFlags.h"
+#include "UringConnection.h"
+
+using std::cerr;
+using std::endl;
+
+using namespace EmbDebug;
+
+//! Constructor when using a port number
+
+//! Sets up the ring, falling back to plain socket calls if we can't.
+
+//! @param[in] _portNum     the port number to connect to
+//! @param[in] _traceFlags  flags controlling tracing
+//! @param[in] _writePort   whether to write the port number to a file
+UringConnection::UringConnection(int _portNum, TraceFlags *_traceFlags,
+                                 bool _writePort)
+    : RspConnection(_portNum, _traceFlags, _writePort), mRingFd(-1),
+      mEventFd(-1), mSqRing(nullptr), mCqRing(nullptr), mSqes(nullptr),
+      mSqRingSize(0), mCqRingSize(0), mSqesSize(0), mRecvBuf(RECV_BUF_SIZE),
+      mRecvPos(0), mRecvEnd(0), mRecvPending(false), mRecvDone(false),
+      mSendPos(0), mSendPending(false), mSendFailed(false) {
+  if (!setupRing())
+    teardownRing();
+}
+
+//! Constructor when using a Unix domain socket
+
+//! Sets up the ring, falling back to plain socket calls if we can't.
+
+//! @param[in] _socketPath  the path of the socket to listen on
+//! @param[in] _traceFlags  flags controlling tracing
+UringConnection::UringConnection(const std::string &_socketPath,
+                                 TraceFlags *_traceFlags)
+    : RspConnection(_socketPath, _traceFlags), mRingFd(-1), mEventFd(-1),
+      mSqRing(nullptr), mCqRing(nullptr), mSqes(nullptr), mSqRingSize(0),
+      mCqRingSize(0), mSqesSize(0), mRecvBuf(RECV_BUF_SIZE), mRecvPos(0),
+      mRecvEnd(0), mRecvPending(false), mRecvDone(false), mSendPos(0),
+      mSendPending(false), mSendFailed(false) {
+  if (!setupRing())
+    teardownRing();
+}
+
+//! Destructor
+
+//! Close the connection, which waits for any operations still in flight,
+//! before releasing the ring.
+UringConnection::~UringConnection() {
+  this->rspClose();
+  teardownRing();
+}
+
+//! Get a new client connection.
+
+//! The connection is made by RspConnection, after which we post the first
+//! receive.
+
+//! @return  TRUE if the connection was established or can be retried. FALSE
+//!          if the error was so serious the program must be aborted.
+bool UringConnection::rspConnect() {
+  if (!RspConnection::rspConnect())
+    return false;
+
+  if (usingUring() && isConnected()) {
+    mRecvDone = false;
+    mSendFailed = false;
+    mSendBuf.clear();
+    mSendPos = 0;
+    mQueuedBuf.clear();
+    postRecv();
+  }
+
+  return true;
+}
+
+//! Close a client connection if it is open
+
+//! Anything still queued (such as the reply to a detach) is sent first. The
+//! socket is then shut down, so that the posted receive completes before the
+//! socket is closed.
+void UringConnection::rspClose() {
+  if (usingUring() && isConnected()) {
+    while (mSendPending) {
+      waitForCompletion();
+      reap();
+    }
+
+    shutdown(RspConnection::getFd(), SHUT_RDWR);
+
+    while (mRecvPending) {
+      waitForCompletion();
+      reap();
+    }
+
+    mRecvPos = 0;
+    mRecvEnd = 0;
+  }
+
+  RspConnection::rspClose();
+}
+
+//! Get a file descriptor for the event loop.
+
+//! Data arrives through the posted receive, so the socket itself may never
+//! look readable. Instead we offer an event file descriptor which the kernel
+//! signals on each completion.
+
+//! @return  The file descriptor, or -1 if we are not connected or the event
+//!          loop can't be used.
+int UringConnection::getFd() {
+  if (!usingUring())
+    return RspConnection::getFd();
+
+  return isConnected() ? mEventFd : -1;
+}
+
+//! Set up the ring
+
+//! @return  TRUE if io_uring is ready to use, FALSE if we must fall back to
+//!          plain socket calls.
+bool UringConnection::setupRing() {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  mRingFd =
+      static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+  if (mRingFd < 0) {
+    cerr << "Warning: io_uring not available: " << strerror(errno)
+         << ": using plain socket calls" << endl;
+    return false;
+  }
+
+  // Map the rings. Newer kernels let the submission and completion rings
+  // share a single mapping.
+  mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  mCqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+  if (singleMmap) {
+    mSqRingSize = std::max(mSqRingSize, mCqRingSize);
+    mCqRingSize = mSqRingSize;
+  }
+
+  mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == mSqRing) {
+    mSqRing = nullptr;
+    cerr << "Warning: Cannot map io_uring: " << strerror(errno)
+         << ": using plain socket calls" << endl;
+    return false;
+  }
+
+  if (singleMmap)
+    mCqRing = mSqRing;
+  else {
+    mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_CQ_RING);
+    if (MAP_FAILED == mCqRing) {
+      mCqRing = nullptr;
+      cerr << "Warning: Cannot map io_uring: " << strerror(errno)
+           << ": using plain socket calls" << endl;
+      return false;
+    }
+  }
+
+  // Kernels from before the send and receive operations still set up the
+  // ring, but fail each of those operations with EINVAL.
+  if (!probeOps())
+    return false;
+
+  mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  mSqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQES);
+  if (MAP_FAILED == mSqes) {
+    mSqes = nullptr;
+    cerr << "Warning: Cannot map io_uring: " << strerror(errno)
+         << ": using plain socket calls" << endl;
+    return false;
+  }
+
+  char *sq = static_cast<char *>(mSqRing);
+  mSqHead = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+  mSqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+  mSqMask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+  mSqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+
+  char *cq = static_cast<char *>(mCqRing);
+  mCqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+  mCqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+  mCqMask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+  mCqes = cq + params.cq_off.cqes;
+
+  // Without an event file descriptor, the event loop can't be used, and the
+  // server will poll instead.
+  mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if ((mEventFd >= 0) && (syscall(__NR_io_uring_register, mRingFd,
+                                  IORING_REGISTER_EVENTFD, &mEventFd, 1) < 0)) {
+    close(mEventFd);
+    mEventFd = -1;
+  }
+
+  if (traceFlags->traceConn())
+    cerr << "Using io_uring for RSP connection" << endl;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+//! Check that the kernel supports the operations we submit
+
+//! @return  TRUE if every operation we use is supported, FALSE otherwise.
+bool UringConnection::probeOps() {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  static const unsigned int NUM_PROBE_OPS = 256;
+  std::vector<char> buf(sizeof(struct io_uring_probe) +
+                        NUM_PROBE_OPS * sizeof(struct io_uring_probe_op));
+  struct io_uring_probe *probe =
+      reinterpret_cast<struct io_uring_probe *>(buf.data());
+
+  if (syscall(__NR_io_uring_register, mRingFd, IORING_REGISTER_PROBE, probe,
+              NUM_PROBE_OPS) < 0) {
+    cerr << "Warning: Cannot probe io_uring: " << strerror(errno)
+         << ": using plain socket calls" << endl;
+    return false;
+  }
+
+  for (unsigned int op : {IORING_OP_SEND, IORING_OP_RECV})
+    if ((op > probe->last_op) ||
+        ((probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)) {
+      cerr << "Warning: io_uring cannot send and receive: using plain "
+              "socket calls"
+           << endl;
+      return false;
+    }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+//! Release the ring, if we have one
+
+//! Also used to clean up after a partial setup, after which we fall back to
+//! plain socket calls.
+void UringConnection::teardownRing() {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  if (mSqes)
+    munmap(mSqes, mSqesSize);
+  if (mCqRing && (mCqRing != mSqRing))
+    munmap(mCqRing, mCqRingSize);
+  if (mSqRing)
+    munmap(mSqRing, mSqRingSize);
+#endif
+
+  mSqes = nullptr;
+  mCqRing = nullptr;
+  mSqRing = nullptr;
+
+  if (-1 != mEventFd) {
+    close(mEventFd);
+    mEventFd = -1;
+  }
+
+  if (-1 != mRingFd) {
+    close(mRingFd);
+    mRingFd = -1;
+  }
+}
+
+//! Submit an operation on the client socket
+
+//! @param[in] op   The operation
+//! @param[in] buf  The buffer to receive into or send from, which must stay
+//!                 valid until the operation completes
+//! @param[in] len  The size of the buffer
+
+//! @return  TRUE if the operation was submitted, FALSE otherwise.
+bool UringConnection::submit(Op op, void *buf, std::size_t len) {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  unsigned int tail = *mSqTail;
+  unsigned int head = __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+
+  if ((tail - head) > *mSqMask) {
+    cerr << "Warning: io_uring submission queue full" << endl;
+    return false;
+  }
+
+  unsigned int idx = tail & *mSqMask;
+  struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(mSqes) + idx;
+  memset(sqe, 0, sizeof(*sqe));
+
+  sqe->opcode = (Op::RECV == op) ? IORING_OP_RECV : IORING_OP_SEND;
+  sqe->fd = RspConnection::getFd();
+  sqe->addr = reinterpret_cast<uintptr_t>(buf);
+  sqe->len = static_cast<unsigned int>(len);
+  sqe->msg_flags = (Op::SEND == op) ? MSG_NOSIGNAL : 0;
+  sqe->user_data = static_cast<unsigned long long>(op);
+
+  mSqArray[idx] = idx;
+  __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+
+  // Hand it to the kernel, retrying after interrupts
+  for (;;) {
+    if (syscall(__NR_io_uring_enter, mRingFd, 1, 0, 0, nullptr, 0) >= 0)
+      return true;
+
+    if (EINTR != errno) {
+      cerr << "Warning: io_uring submission failed: " << strerror(errno)
+           << endl;
+      return false;
+    }
+  }
+#else
+  (void)op;
+  (void)buf;
+  (void)len;
+  return false;
+#endif
+}
+
+//! Post a receive into our receive buffer
+
+void UringConnection::postRecv() {
+  mRecvPos = 0;
+  mRecvEnd = 0;
+  mRecvPending = submit(Op::RECV, mRecvBuf.data(), mRecvBuf.size());
+
+  if (!mRecvPending)
+    mRecvDone = true;
+}
+
+//! Post a send of whatever is left of the send buffer
+
+void UringConnection::postSend() {
+  mSendPending =
+      submit(Op::SEND, &mSendBuf[mSendPos], mSendBuf.size() - mSendPos);
+
+  if (!mSendPending)
+    mSendFailed = true;
+}
+
+//! Deal with every completion the kernel has posted, without waiting
+
+void UringConnection::reap() {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  // Clear the event file descriptor first, so that any completion after
+  // this point signals it again.
+  if (-1 != mEventFd) {
+    uint64_t count;
+    if (read(mEventFd, &count, sizeof(count)) < 0) {
+      // Nothing to clear
+    }
+  }
+
+  struct io_uring_cqe *cqes = static_cast<struct io_uring_cqe *>(mCqes);
+  unsigned int head = *mCqHead;
+
+  while (head != __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = &cqes[head & *mCqMask];
+    Op op = static_cast<Op>(cqe->user_data);
+    int res = cqe->res;
+
+    // Free the slot before acting on it, since that may submit more work.
+    __atomic_store_n(mCqHead, ++head, __ATOMIC_RELEASE);
+    complete(op, res);
+  }
+#endif
+}
+
+//! Wait until the kernel posts at least one completion
+
+void UringConnection::waitForCompletion() {
+#ifdef EMBDEBUG_HAVE_IO_URING
+  if ((syscall(__NR_io_uring_enter, mRingFd, 0, 1, IORING_ENTER_GETEVENTS,
+               nullptr, 0) < 0) &&
+      (EINTR != errno))
+    cerr << "Warning: io_uring wait failed: " << strerror(errno) << endl;
+#endif
+}
+
+//! Act on a completed operation
+
+//! @param[in] op   The operation which completed
+//! @param[in] res  Its result: a byte count, or a negated errno value
+void UringConnection::complete(Op op, int res) {
+  switch (op) {
+  case Op::RECV:
+    mRecvPending = false;
+
+    if (res > 0) {
+      mRecvPos = 0;
+      mRecvEnd = static_cast<std::size_t>(res);
+    } else if ((-EINTR == res) || (-EAGAIN == res))
+      postRecv();
+    else {
+      if (res < 0)
+        cerr << "Warning: Failed to read from RSP client: " << strerror(-res)
+             << endl;
+
+      mRecvDone = true; // Error, or end of file
+    }
+
+    break;
+
+  case Op::SEND:
+    mSendPending = false;
+
+    if ((-EINTR == res) || (-EAGAIN == res))
+      postSend();
+    else if (res < 0) {
+      cerr << "Warning: Failed to write to RSP client: " << strerror(-res)
+           << endl;
+      mSendFailed = true;
+    } else {
+      // Carry on with the rest of a partial send, or start on whatever has
+      // been queued since.
+      mSendPos += static_cast<std::size_t>(res);
+
+      if (mSendPos < mSendBuf.size())
+        postSend();
+      else if (!mQueuedBuf.empty()) {
+        mSendBuf.swap(mQueuedBuf);
+        mQueuedBuf.clear();
+        mSendPos = 0;
+        postSend();
+      }
+    }
+
+    break;
+  }
+}
+
+//! Put a buffer of characters out on the RSP connection
+
+//! The characters are queued, and we return without waiting for them to be
+//! sent. Only if the client falls a long way behind do we wait for it.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if the chars were queued OK, FALSE if not (communications
+//!          failure)
+bool UringConnection::putRspBytesRaw(const char *buf, std::size_t len) {
+  if (!usingUring())
+    return RspConnection::putRspBytesRaw(buf, len);
+
+  if (!isConnected()) {
+    cerr << "Warning: Attempt to write " << len
+         << " chars to unopened RSP client: Ignored" << endl;
+    return false;
+  }
+
+  reap();
+
+  while (mSendPending && !mSendFailed &&
+         (mQueuedBuf.size() > SEND_HIGH_WATER)) {
+    waitForCompletion();
+    reap();
+  }
+
+  if (mSendFailed)
+    return false;
+
+  mQueuedBuf.insert(mQueuedBuf.end(), buf, buf + len);
+
+  if (!mSendPending) {
+    mSendBuf.swap(mQueuedBuf);
+    mQueuedBuf.clear();
+    mSendPos = 0;
+    postSend();
+  }
+
+  return !mSendFailed;
+}
+
+//! Get as many characters as are available from the RSP connection
+
+//! The characters come from the posted receive, which is posted again as
+//! soon as all of its data has been handed over.
+
+//! @param[out] buf       Buffer for the characters read
+//! @param[in]  len       Size of the buffer
+//! @param[in]  blocking  True if the read should block.
+//! @return  The number of characters received or -1 on failure, or if the
+//!          read would block, and blocking is false.
+int UringConnection::getRspBytesRaw(char *buf, std::size_t len,
+                                    bool blocking) {
+  if (!usingUring())
+    return RspConnection::getRspBytesRaw(buf, len, blocking);
+
+  if (!isConnected()) {
+    cerr << "Warning: Attempt to read from "
+         << "unopened RSP client: Ignored" << endl;
+    return -1;
+  }
+
+  for (;;) {
+    reap();
+
+    if (mRecvPos < mRecvEnd) {
+      std::size_t count = std::min(len, mRecvEnd - mRecvPos);
+      memcpy(buf, &mRecvBuf[mRecvPos], count);
+      mRecvPos += count;
+
+      if (mRecvPos == mRecvEnd)
+        postRecv();
+
+      return static_cast<int>(count);
+    }
+
+    if (mRecvDone || !mRecvPending || !blocking)
+      return -1;
+
+    waitForCompletion();
+  }
+}
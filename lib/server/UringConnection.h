@@ -0,0 +1,152 @@
+// Remote Serial Protocol connection using io_uring: declaration
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+#ifndef URING_CONNECTION_H
+#define URING_CONNECTION_H
+
+#include <string>
+#include <vector>
+
+#include "RspConnection.h"
+
+namespace EmbDebug {
+
+class TraceFlags;
+
+//! Class implementing an RSP socket connection driven through io_uring
+
+//! Connections are made in the same way as for RspConnection, but once a
+//! client is connected a receive is kept posted at all times, and sends are
+//! queued to the kernel without waiting for them to complete. The target can
+//! then carry on running while a large reply is still being sent.
+
+//! If io_uring is not available on the host, or is refused by the running
+//! kernel, this behaves exactly like RspConnection.
+
+class UringConnection : public RspConnection {
+public:
+  // Constructors and destructor
+
+  UringConnection(int _portNum, TraceFlags *_traceFlags, bool _writePort);
+  UringConnection(const std::string &_socketPath, TraceFlags *_traceFlags);
+  ~UringConnection();
+
+  // Public interface: manage client connections
+
+  bool rspConnect();
+  void rspClose();
+  virtual int getFd();
+
+  // Are we using io_uring, or have we fallen back to plain socket calls?
+
+  bool usingUring() const { return -1 != mRingFd; }
+
+protected:
+  // Tear down the ring, falling back to plain socket calls
+
+  void teardownRing();
+
+private:
+  //! Number of entries in each ring. We never have more than one receive
+  //! and one send in flight.
+
+  static const unsigned int RING_ENTRIES = 4;
+
+  //! Size of the buffer the posted receive reads into.
+
+  static const std::size_t RECV_BUF_SIZE = 16384;
+
+  //! Amount of unsent data we will queue before waiting for the client to
+  //! catch up.
+
+  static const std::size_t SEND_HIGH_WATER = 1 << 20;
+
+  //! The operations we submit, also used to tag their completions
+
+  enum class Op : unsigned long long { RECV = 1, SEND = 2 };
+
+  //! The io_uring file descriptor, or -1 if we have fallen back
+
+  int mRingFd;
+
+  //! Event file descriptor signalled on each completion, for the event loop
+
+  int mEventFd;
+
+  // The rings shared with the kernel
+
+  void *mSqRing;
+  void *mCqRing;
+  void *mSqes;
+  std::size_t mSqRingSize;
+  std::size_t mCqRingSize;
+  std::size_t mSqesSize;
+
+  unsigned int *mSqHead;
+  unsigned int *mSqTail;
+  unsigned int *mSqMask;
+  unsigned int *mSqArray;
+  unsigned int *mCqHead;
+  unsigned int *mCqTail;
+  unsigned int *mCqMask;
+  void *mCqes;
+
+  //! Buffer for the posted receive, and the part of it not yet consumed
+
+  std::vector<char> mRecvBuf;
+  std::size_t mRecvPos;
+  std::size_t mRecvEnd;
+
+  //! Is a receive posted?
+
+  bool mRecvPending;
+
+  //! Has the client closed its end (or the receive failed)?
+
+  bool mRecvDone;
+
+  //! Data being sent by the send in flight, and how much has gone so far
+
+  std::vector<char> mSendBuf;
+  std::size_t mSendPos;
+
+  //! Data queued behind the send in flight
+
+  std::vector<char> mQueuedBuf;
+
+  //! Is a send in flight?
+
+  bool mSendPending;
+
+  //! Has a send failed?
+
+  bool mSendFailed;
+
+  // Setting up the ring
+
+  bool setupRing();
+  bool probeOps();
+
+  // Submitting and completing operations
+
+  bool submit(Op op, void *buf, std::size_t len);
+  void postRecv();
+  void postSend();
+  void reap();
+  void waitForCompletion();
+  void complete(Op op, int res);
+
+  // Implementation specific routines to handle chars.
+
+  virtual bool putRspBytesRaw(const char *buf, std::size_t len);
+  virtual int getRspBytesRaw(char *buf, std::size_t len, bool blocking);
+};
+
+} // namespace EmbDebug
+
+#endif
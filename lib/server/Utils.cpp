@@ -52,26 +52,15 @@ void Utils::regVal2Hex(uint64_t val, char *buf, std::size_t numBytes,
                        bool isLittleEndianP) {
   assert(buf);
   assert(numBytes <= sizeof(uint64_t));
-  if (isLittleEndianP) {
-    for (std::size_t n = 0; n < numBytes; n++) {
-      unsigned char byte = val & 0xff;
+  uint8_t bytes[sizeof(uint64_t)];
 
-      buf[n * 2] = hex2Char((byte >> 4) & 0xf);
-      buf[n * 2 + 1] = hex2Char(byte & 0xf);
-
-      val = val / 256;
-    }
-  } else {
-    for (std::size_t n = numBytes; n-- > 0;) {
-      unsigned char byte = val & 0xff;
-
-      buf[n * 2] = hex2Char((byte >> 4) & 0xf);
-      buf[n * 2 + 1] = hex2Char(byte & 0xf);
-
-      val = val / 256;
-    }
+  // Lay the bytes out in order, then convert them all at once
+  for (std::size_t n = 0; n < numBytes; n++) {
+    bytes[isLittleEndianP ? n : numBytes - 1 - n] = val & 0xff;
+    val = val / 256;
   }
 
+  hexEncode(buf, bytes, numBytes);
   buf[numBytes * 2] = '\0'; // Useful to terminate as string
 }
 
@@ -79,20 +68,16 @@ uint64_t Utils::hex2RegVal(const char *buf, std::size_t numBytes,
                            bool isLittleEndianP) {
   assert(buf);
   assert(numBytes <= sizeof(uint64_t));
-  assert(isHexStr(buf, numBytes));
   uint64_t val = 0; // The result
+  uint8_t bytes[sizeof(uint64_t)];
 
-  if (isLittleEndianP) {
-    for (std::size_t n = numBytes; n-- > 0;) {
-      val = (val << 4) | char2Hex(buf[n * 2]);
-      val = (val << 4) | char2Hex(buf[n * 2 + 1]);
-    }
-  } else {
-    for (std::size_t n = 0; n < numBytes; n++) {
-      val = (val << 4) | char2Hex(buf[n * 2]);
-      val = (val << 4) | char2Hex(buf[n * 2 + 1]);
-    }
-  }
+  // Convert all the bytes at once, then assemble them in order
+  bool valid = hexDecode(bytes, buf, numBytes);
+  assert(valid);
+  (void)valid;
+
+  for (std::size_t n = 0; n < numBytes; n++)
+    val = (val << 8) | bytes[isLittleEndianP ? numBytes - 1 - n : n];
 
   return val;
 }
@@ -164,17 +149,25 @@ std::size_t Utils::rspUnescape(char *buf, std::size_t len) {
   std::size_t fromOffset = 0; // Offset to source char
   std::size_t toOffset = 0;   // Offset to dest char
 
+  // Move each run of unescaped chars in one go
   while (fromOffset < len) {
-    // Is it escaped
-    if ('}' == buf[fromOffset]) {
-      fromOffset++;
-      buf[toOffset] = buf[fromOffset] ^ 0x20;
-    } else {
-      buf[toOffset] = buf[fromOffset];
-    }
+    const char *esc = static_cast<const char *>(
+        memchr(&buf[fromOffset], '}', len - fromOffset));
+    std::size_t run = (esc != nullptr) ? esc - &buf[fromOffset]
+                                       : len - fromOffset;
+
+    if (toOffset != fromOffset)
+      memmove(&buf[toOffset], &buf[fromOffset], run);
 
-    fromOffset++;
-    toOffset++;
+    fromOffset += run;
+    toOffset += run;
+
+    // Is it escaped
+    if ((fromOffset + 1) < len) {
+      buf[toOffset++] = buf[fromOffset + 1] ^ 0x20;
+      fromOffset += 2;
+    } else
+      break;
   }
 
   return toOffset;
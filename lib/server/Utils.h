@@ -44,6 +44,85 @@ uint8_t char2Hex(int c);
 //!         or '\0' if an invalid value was provided.
 char hex2Char(uint8_t d);
 
+//! \brief Convert bytes to pairs of hex digits
+//!
+//! Each byte becomes two lower case hex digits, high nibble first. The
+//! result is not null terminated. SIMD instructions are used where the host
+//! has them.
+//!
+//! \param[out] dest  Buffer for (2 * \p len) hex digits
+//! \param[in]  src   The bytes to convert
+//! \param[in]  len   The number of bytes
+void hexEncode(char *dest, const uint8_t *src, std::size_t len);
+
+//! \brief Convert pairs of hex digits to bytes
+//!
+//! Upper and lower case digits are accepted. SIMD instructions are used
+//! where the host has them.
+//!
+//! \param[out] dest  Buffer for \p len bytes
+//! \param[in]  src   The (2 * \p len) hex digits
+//! \param[in]  len   The number of bytes
+//! \return  True if all the digits were valid, false otherwise, in which
+//!          case the contents of \p dest are undefined.
+bool hexDecode(uint8_t *dest, const char *src, std::size_t len);
+
+//! \brief Scalar version of hexEncode, used to check the SIMD versions
+void hexEncodeScalar(char *dest, const uint8_t *src, std::size_t len);
+
+//! \brief Scalar version of hexDecode, used to check the SIMD versions
+bool hexDecodeScalar(uint8_t *dest, const char *src, std::size_t len);
+
+//! \brief Scan RSP packet data for the next char to be escaped
+//!
+//! Looks for the first '$', '#', '*' or '}', adding every char before it to
+//! a running checksum, so that a packet can be framed in one pass. SIMD
+//! instructions are used where the host has them.
+//!
+//! \param[in]     buf       The packet data
+//! \param[in]     len       The number of chars of data
+//! \param[in,out] checksum  The checksum so far, updated
+//! \return  The offset of the char to be escaped, or \p len if there is none.
+std::size_t rspScanEscape(const char *buf, std::size_t len,
+                          unsigned char &checksum);
+
+//! \brief Scan received RSP packet data for its end
+//!
+//! Looks for the first '#' (ending the packet) or '$' (restarting it),
+//! adding every char before it to a running checksum, so that a packet can
+//! be checked in one pass. SIMD instructions are used where the host has
+//! them.
+//!
+//! \param[in]     buf       The packet data received so far
+//! \param[in]     len       The number of chars received
+//! \param[in,out] checksum  The checksum so far, updated
+//! \return  The offset of the '#' or '$', or \p len if there is none.
+std::size_t rspScanPacket(const char *buf, std::size_t len,
+                          unsigned char &checksum);
+
+namespace detail {
+
+//! \brief One version of the bulk hex conversions and packet scanning
+struct HexKernels {
+  const char *name;
+  void (*encode)(char *dest, const uint8_t *src, std::size_t len);
+  bool (*decode)(uint8_t *dest, const char *src, std::size_t len);
+  std::size_t (*scanEscape)(const char *buf, std::size_t len,
+                            unsigned char &checksum);
+  std::size_t (*scanPacket)(const char *buf, std::size_t len,
+                            unsigned char &checksum);
+};
+
+//! \brief Every version built in which the host can run
+//!
+//! The scalar version comes first, and the version used by hexEncode,
+//! hexDecode, rspScanEscape and rspScanPacket last. Exposed so that each
+//! version can be checked against the scalar one, whichever the host would
+//! choose.
+std::vector<HexKernels> hexKernels();
+
+} // namespace detail
+
 //! \brief Convert a register value to a hex digit string
 //!
 //! The supplied value is converted to a (\p numBytes * 2) digit hex string. The
@@ -0,0 +1,466 @@
+// GDB Server Utilties: bulk hex conversion and packet scanning
+//
+// This file is part of the Embecosm GDB Server.
+//
+// Copyright (C) 2009-2019 Embecosm Limited
+// SPDX-License-Identifier: GPL-3.0-or-later
+// ----------------------------------------------------------------------------
+
+// Memory reads and writes through 'm' and 'M' packets carry every byte as a
+// pair of hex digits, so for large transfers hex conversion dominates. The
+// conversions here work on whole buffers, using SIMD instructions where the
+// host has them, chosen when first used. Each vector version handles whole
+// blocks and leaves any tail to the scalar version, and all must give
+// exactly the same results as the scalar version.
+//
+// Framing and receiving packets similarly means looking at every char of
+// the packet for the few which are special, while summing them all for the
+// checksum. The scanning here does both in one pass.
+
+#include <cstring>
+
+#include "Utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define EMBDEBUG_HEX_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+#define EMBDEBUG_HEX_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define EMBDEBUG_HEX_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace EmbDebug;
+
+namespace {
+
+//! Value of each char as a hex digit, or -1 if it isn't one
+
+struct HexTable {
+  int8_t val[256];
+
+  HexTable() {
+    memset(val, -1, sizeof(val));
+
+    for (int i = 0; i < 10; i++)
+      val['0' + i] = static_cast<int8_t>(i);
+
+    for (int i = 0; i < 6; i++) {
+      val['a' + i] = static_cast<int8_t>(10 + i);
+      val['A' + i] = static_cast<int8_t>(10 + i);
+    }
+  }
+};
+
+const HexTable hexTable;
+
+const char hexDigits[] = "0123456789abcdef";
+
+using Utils::hexDecodeScalar;
+using Utils::hexEncodeScalar;
+
+// Chars which must be escaped in packet data, and chars which end (or
+// restart) a packet being received. Each set is padded to four chars, so
+// that the same scanning code serves for both.
+
+const char escapeChars[4] = {'$', '#', '*', '}'};
+const char packetEndChars[4] = {'$', '#', '$', '#'};
+
+// Find the first of the stop chars, adding every char before it to the
+// checksum. Also used to finish off for the vector versions.
+
+std::size_t rspScanScalar(const char *buf, std::size_t len, const char *stops,
+                          unsigned char &checksum) {
+  unsigned char sum = checksum;
+  std::size_t i;
+
+  for (i = 0; i < len; i++) {
+    char ch = buf[i];
+
+    if ((ch == stops[0]) || (ch == stops[1]) || (ch == stops[2]) ||
+        (ch == stops[3]))
+      break;
+
+    sum += static_cast<unsigned char>(ch);
+  }
+
+  checksum = sum;
+  return i;
+}
+
+#ifdef EMBDEBUG_HEX_SSE2
+
+// Nibbles (0-15) to hex digits: '0' + n, plus 39 more for 'a'-'f'.
+
+inline __m128i nibblesToHexSse2(__m128i n) {
+  __m128i letters = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+  __m128i offset = _mm_add_epi8(_mm_set1_epi8('0'),
+                                _mm_and_si128(letters, _mm_set1_epi8(39)));
+  return _mm_add_epi8(n, offset);
+}
+
+// Hex digits to nibbles. Chars which are not hex digits clear their bit in
+// the valid mask.
+
+inline __m128i hexToNibblesSse2(__m128i c, int &validMask) {
+  __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+                                  _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+  __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+                           _mm_set1_epi8('a'));
+  __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8(-1)),
+                                   _mm_cmplt_epi8(l, _mm_set1_epi8(6)));
+  validMask = _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter));
+  return _mm_or_si128(
+      _mm_and_si128(isDigit, d),
+      _mm_and_si128(isLetter, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+void hexEncodeSse2(char *dest, const uint8_t *src, std::size_t len) {
+  const __m128i lowNibble = _mm_set1_epi8(0x0f);
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    __m128i hi =
+        nibblesToHexSse2(_mm_and_si128(_mm_srli_epi16(v, 4), lowNibble));
+    __m128i lo = nibblesToHexSse2(_mm_and_si128(v, lowNibble));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 2),
+                     _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 2 + 16),
+                     _mm_unpackhi_epi8(hi, lo));
+  }
+
+  hexEncodeScalar(dest + i * 2, src + i, len - i);
+}
+
+bool hexDecodeSse2(uint8_t *dest, const char *src, std::size_t len) {
+  std::size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+    int validMask;
+    __m128i n = hexToNibblesSse2(c, validMask);
+
+    if (validMask != 0xffff)
+      return false;
+
+    // Each 16 bit lane holds the high nibble in its low byte, and the low
+    // nibble in its high byte.
+    __m128i bytes = _mm_and_si128(
+        _mm_or_si128(_mm_slli_epi16(n, 4), _mm_srli_epi16(n, 8)),
+        _mm_set1_epi16(0xff));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dest + i),
+                     _mm_packus_epi16(bytes, bytes));
+  }
+
+  return hexDecodeScalar(dest + i, src + i * 2, len - i);
+}
+
+std::size_t rspScanSse2(const char *buf, std::size_t len, const char *stops,
+                        unsigned char &checksum) {
+  const __m128i s0 = _mm_set1_epi8(stops[0]);
+  const __m128i s1 = _mm_set1_epi8(stops[1]);
+  const __m128i s2 = _mm_set1_epi8(stops[2]);
+  const __m128i s3 = _mm_set1_epi8(stops[3]);
+  __m128i sum = _mm_setzero_si128(); // Two 64 bit partial sums
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + i));
+    __m128i hit01 = _mm_or_si128(_mm_cmpeq_epi8(v, s0), _mm_cmpeq_epi8(v, s1));
+    __m128i hit23 = _mm_or_si128(_mm_cmpeq_epi8(v, s2), _mm_cmpeq_epi8(v, s3));
+    __m128i hit = _mm_or_si128(hit01, hit23);
+
+    if (_mm_movemask_epi8(hit) != 0)
+      break; // Leave this block to the scalar version
+
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(v, _mm_setzero_si128()));
+  }
+
+  uint64_t partial[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(partial), sum);
+  checksum += static_cast<unsigned char>(partial[0] + partial[1]);
+  return i + rspScanScalar(buf + i, len - i, stops, checksum);
+}
+
+#endif
+
+#ifdef EMBDEBUG_HEX_AVX2
+
+#define EMBDEBUG_AVX2_FN __attribute__((target("avx2")))
+
+EMBDEBUG_AVX2_FN inline __m256i nibblesToHexAvx2(__m256i n) {
+  __m256i letters = _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9));
+  __m256i offset = _mm256_add_epi8(
+      _mm256_set1_epi8('0'), _mm256_and_si256(letters, _mm256_set1_epi8(39)));
+  return _mm256_add_epi8(n, offset);
+}
+
+EMBDEBUG_AVX2_FN inline __m256i hexToNibblesAvx2(__m256i c, int &validMask) {
+  __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+  __m256i isDigit = _mm256_and_si256(
+      _mm256_cmpgt_epi8(d, _mm256_set1_epi8(-1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(10), d));
+  __m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)),
+                              _mm256_set1_epi8('a'));
+  __m256i isLetter = _mm256_and_si256(
+      _mm256_cmpgt_epi8(l, _mm256_set1_epi8(-1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(6), l));
+  validMask = _mm256_movemask_epi8(_mm256_or_si256(isDigit, isLetter));
+  return _mm256_or_si256(
+      _mm256_and_si256(isDigit, d),
+      _mm256_and_si256(isLetter, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+}
+
+EMBDEBUG_AVX2_FN void hexEncodeAvx2(char *dest, const uint8_t *src,
+                                    std::size_t len) {
+  const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+  std::size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    __m256i hi = nibblesToHexAvx2(
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble));
+    __m256i lo = nibblesToHexAvx2(_mm256_and_si256(v, lowNibble));
+
+    // Unpacking works within 128 bit lanes, so put the lanes back in order.
+    __m256i first = _mm256_unpacklo_epi8(hi, lo);
+    __m256i second = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i * 2),
+                        _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i * 2 + 32),
+                        _mm256_permute2x128_si256(first, second, 0x31));
+  }
+
+  hexEncodeScalar(dest + i * 2, src + i, len - i);
+}
+
+EMBDEBUG_AVX2_FN bool hexDecodeAvx2(uint8_t *dest, const char *src,
+                                    std::size_t len) {
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2));
+    int validMask;
+    __m256i n = hexToNibblesAvx2(c, validMask);
+
+    if (validMask != -1)
+      return false;
+
+    __m256i bytes = _mm256_and_si256(
+        _mm256_or_si256(_mm256_slli_epi16(n, 4), _mm256_srli_epi16(n, 8)),
+        _mm256_set1_epi16(0xff));
+
+    // Packing also works within lanes, leaving the 8 bytes from each lane in
+    // the first and third quarters.
+    __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(bytes, bytes), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                     _mm256_castsi256_si128(packed));
+  }
+
+  return hexDecodeScalar(dest + i, src + i * 2, len - i);
+}
+
+EMBDEBUG_AVX2_FN std::size_t rspScanAvx2(const char *buf, std::size_t len,
+                                         const char *stops,
+                                         unsigned char &checksum) {
+  const __m256i s0 = _mm256_set1_epi8(stops[0]);
+  const __m256i s1 = _mm256_set1_epi8(stops[1]);
+  const __m256i s2 = _mm256_set1_epi8(stops[2]);
+  const __m256i s3 = _mm256_set1_epi8(stops[3]);
+  __m256i sum = _mm256_setzero_si256(); // Four 64 bit partial sums
+  std::size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i));
+    __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, s0), _mm256_cmpeq_epi8(v, s1)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, s2), _mm256_cmpeq_epi8(v, s3)));
+
+    if (_mm256_movemask_epi8(hit) != 0)
+      break; // Leave this block to the scalar version
+
+    sum = _mm256_add_epi64(sum, _mm256_sad_epu8(v, _mm256_setzero_si256()));
+  }
+
+  uint64_t partial[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(partial), sum);
+  checksum += static_cast<unsigned char>(partial[0] + partial[1] +
+                                         partial[2] + partial[3]);
+  return i + rspScanScalar(buf + i, len - i, stops, checksum);
+}
+
+#endif
+
+#ifdef EMBDEBUG_HEX_NEON
+
+void hexEncodeNeon(char *dest, const uint8_t *src, std::size_t len) {
+  const uint8x16_t digits =
+      vld1q_u8(reinterpret_cast<const uint8_t *>(hexDigits));
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t v = vld1q_u8(src + i);
+    uint8x16x2_t out;
+    out.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+    out.val[1] = vqtbl1q_u8(digits, vandq_u8(v, vdupq_n_u8(0x0f)));
+    vst2q_u8(reinterpret_cast<uint8_t *>(dest + i * 2), out);
+  }
+
+  hexEncodeScalar(dest + i * 2, src + i, len - i);
+}
+
+inline uint8x16_t hexToNibblesNeon(uint8x16_t c, uint8x16_t &valid) {
+  uint8x16_t d = vsubq_u8(c, vdupq_n_u8('0'));
+  uint8x16_t isDigit = vcltq_u8(d, vdupq_n_u8(10));
+  uint8x16_t l = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+  uint8x16_t isLetter = vcltq_u8(l, vdupq_n_u8(6));
+  valid = vandq_u8(valid, vorrq_u8(isDigit, isLetter));
+  return vbslq_u8(isDigit, d, vaddq_u8(l, vdupq_n_u8(10)));
+}
+
+bool hexDecodeNeon(uint8_t *dest, const char *src, std::size_t len) {
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16x2_t c = vld2q_u8(reinterpret_cast<const uint8_t *>(src + i * 2));
+    uint8x16_t valid = vdupq_n_u8(0xff);
+    uint8x16_t hi = hexToNibblesNeon(c.val[0], valid);
+    uint8x16_t lo = hexToNibblesNeon(c.val[1], valid);
+
+    if (vminvq_u8(valid) != 0xff)
+      return false;
+
+    vst1q_u8(dest + i, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+  }
+
+  return hexDecodeScalar(dest + i, src + i * 2, len - i);
+}
+
+std::size_t rspScanNeon(const char *buf, std::size_t len, const char *stops,
+                        unsigned char &checksum) {
+  const uint8x16_t s0 = vdupq_n_u8(static_cast<uint8_t>(stops[0]));
+  const uint8x16_t s1 = vdupq_n_u8(static_cast<uint8_t>(stops[1]));
+  const uint8x16_t s2 = vdupq_n_u8(static_cast<uint8_t>(stops[2]));
+  const uint8x16_t s3 = vdupq_n_u8(static_cast<uint8_t>(stops[3]));
+  unsigned int sum = 0;
+  std::size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(buf + i));
+    uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, s0), vceqq_u8(v, s1)),
+                              vorrq_u8(vceqq_u8(v, s2), vceqq_u8(v, s3)));
+
+    if (vmaxvq_u8(hit) != 0)
+      break; // Leave this block to the scalar version
+
+    sum += vaddlvq_u8(v);
+  }
+
+  checksum += static_cast<unsigned char>(sum);
+  return i + rspScanScalar(buf + i, len - i, stops, checksum);
+}
+
+#endif
+
+// Each version of scanning serves for both sets of stop chars.
+
+template <std::size_t (*Scan)(const char *, std::size_t, const char *,
+                              unsigned char &)>
+std::size_t scanEscape(const char *buf, std::size_t len,
+                       unsigned char &checksum) {
+  return Scan(buf, len, escapeChars, checksum);
+}
+
+template <std::size_t (*Scan)(const char *, std::size_t, const char *,
+                              unsigned char &)>
+std::size_t scanPacket(const char *buf, std::size_t len,
+                       unsigned char &checksum) {
+  return Scan(buf, len, packetEndChars, checksum);
+}
+
+using Utils::detail::HexKernels;
+
+// Choosing the version to use: the last one the host can run.
+
+const HexKernels &kernels() {
+  static const HexKernels chosen = Utils::detail::hexKernels().back();
+  return chosen;
+}
+
+} // namespace
+
+std::vector<HexKernels> Utils::detail::hexKernels() {
+  std::vector<HexKernels> all;
+  all.push_back({"scalar", hexEncodeScalar, hexDecodeScalar,
+                 scanEscape<rspScanScalar>, scanPacket<rspScanScalar>});
+#if defined(EMBDEBUG_HEX_NEON)
+  all.push_back({"neon", hexEncodeNeon, hexDecodeNeon,
+                 scanEscape<rspScanNeon>, scanPacket<rspScanNeon>});
+#elif defined(EMBDEBUG_HEX_SSE2)
+  all.push_back({"sse2", hexEncodeSse2, hexDecodeSse2,
+                 scanEscape<rspScanSse2>, scanPacket<rspScanSse2>});
+#endif
+#ifdef EMBDEBUG_HEX_AVX2
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    all.push_back({"avx2", hexEncodeAvx2, hexDecodeAvx2,
+                   scanEscape<rspScanAvx2>, scanPacket<rspScanAvx2>});
+#endif
+
+  return all;
+}
+
+// Scalar versions, which also handle the tails for the vector versions.
+
+void Utils::hexEncodeScalar(char *dest, const uint8_t *src, std::size_t len) {
+  for (std::size_t i = 0; i < len; i++) {
+    dest[i * 2] = hexDigits[src[i] >> 4];
+    dest[i * 2 + 1] = hexDigits[src[i] & 0xf];
+  }
+}
+
+bool Utils::hexDecodeScalar(uint8_t *dest, const char *src, std::size_t len) {
+  for (std::size_t i = 0; i < len; i++) {
+    int hi = hexTable.val[static_cast<uint8_t>(src[i * 2])];
+    int lo = hexTable.val[static_cast<uint8_t>(src[i * 2 + 1])];
+
+    if ((hi < 0) || (lo < 0))
+      return false;
+
+    dest[i] = static_cast<uint8_t>((hi << 4) | lo);
+  }
+
+  return true;
+}
+
+void Utils::hexEncode(char *dest, const uint8_t *src, std::size_t len) {
+  kernels().encode(dest, src, len);
+}
+
+bool Utils::hexDecode(uint8_t *dest, const char *src, std::size_t len) {
+  return kernels().decode(dest, src, len);
+}
+
+std::size_t Utils::rspScanEscape(const char *buf, std::size_t len,
+                                 unsigned char &checksum) {
+  return kernels().scanEscape(buf, len, checksum);
+}
+
+std::size_t Utils::rspScanPacket(const char *buf, std::size_t len,
+                                 unsigned char &checksum) {
+  return kernels().scanPacket(buf, len, checksum);
+}
@@ -7,10 +7,9 @@
 // ----------------------------------------------------------------------------
 
 #include "VContActions.h"
-#include "Utils.h"
+#include "PacketParser.h"
 
 #include <cassert>
-#include <cstring>
 #include <string>
 #include <vector>
 
@@ -25,38 +24,40 @@ using namespace EmbDebug;
 // if everything parsed correctly, otherwise return false.  If we return
 // false then the state of this object is undefined.
 
-bool VContActions::parse(const char *str) {
-  vector<string> tokens;
+bool VContActions::parse(ByteView str) {
+  PacketParser parser(str);
 
-  // Skip the leading 'vCont;' header.
-  str += strlen("vCont;");
-  Utils::split(str, ";", tokens);
+  // Skip the leading 'vCont;' header. The actions are separated by ';'.
+  if (!(parser.expect("vCont") && parser.skip(1)))
+    return false;
 
-  for (auto it = tokens.begin(); it != tokens.end(); ++it) {
-    const char *tmp;
-    std::size_t pos;
+  do {
+    PacketParser actionParser(parser.field(';'));
+    ByteView action = actionParser.field(':');
     Ptid ptid(Ptid::PTID_ALL, Ptid::PTID_ALL);
 
-    // Find the ':', the start of the pid/tid descriptor.
-    pos = it->find(':');
-    if (pos != std::string::npos) {
-      // Convert the pid/tid into a decoded object.
-      tmp = it->c_str() + pos + 1;
-      if (!ptid.decode(tmp))
+    // Skip empty actions
+    if (action.getLen() == 0)
+      continue;
+
+    // Anything after a ':' is the pid/tid the action applies to. Convert
+    // it into a decoded object.
+    if (actionParser.expect(':')) {
+      if (!actionParser.ptid(ptid))
         return false;
 
       if (ptid.pid() == 0) {
-        cerr << "Warning: found pid == 0 in vCont '" << str << "'" << endl;
+        cerr << "Warning: found pid == 0 in vCont '"
+             << string(str.getData(), str.getLen()) << "'" << endl;
         return false;
       }
     }
 
     // Store the details into the actions vector.
-    std::string action = *it;
-    mActions.push_back(std::make_pair(action, ptid));
-  }
+    mActions.push_back(std::make_pair(action[0], ptid));
+  } while (parser.expect(';'));
 
-  return true;
+  return parser.atEnd();
 }
 
 // Return true if this vCont packet effects more than one core.  This is
@@ -99,7 +100,7 @@ char VContActions::getCoreAction(unsigned int num) const {
 
     assert(pid != 0);
     if ((pid == ((unsigned int)-1)) || pid == num)
-      return (it->first.c_str())[0];
+      return it->first;
   }
 
   return '\0';
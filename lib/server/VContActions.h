@@ -10,6 +10,7 @@
 #define VCONT_ACTIONS_H
 
 #include "Ptid.h"
+#include "embdebug/ByteView.h"
 
 #include <vector>
 
@@ -18,7 +19,7 @@ namespace EmbDebug {
 class VContActions {
 public:
   // Decode vCont packet in STR.
-  VContActions(const char *str) { mValid = parse(str); }
+  VContActions(ByteView str) { mValid = parse(str); }
 
   // Return true if the vCont packet was decoded successfully, otherwise,
   // return false.  Other than the constructor you should not call any
@@ -41,14 +42,14 @@ private:
 
   // Actually parse the vCont packet, return true if the parse was OK,
   // otherwise return false.
-  bool parse(const char *str);
+  bool parse(ByteView str);
 
   // Is this object valid.
   bool mValid;
 
-  // The list of actions extracted from the vCont packet.  This is a pretty
-  // crude storage format, which we should probably improve on.
-  std::vector<std::pair<std::string, Ptid>> mActions;
+  // The list of actions extracted from the vCont packet: the action letter
+  // and the thread it applies to.
+  std::vector<std::pair<char, Ptid>> mActions;
 };
 
 } // namespace EmbDebug
@@ -1,4 +1,6 @@
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 
 #include "embdebug/Compat.h"
 
@@ -29,9 +31,11 @@ public:
     _buf = buf;
     _pos = 0;
   }
+  std::string getOutBuf() { return _outBuf; }
 
 protected:
-  virtual bool putRspCharRaw(char c EMBDEBUG_ATTR_UNUSED) override { /* TBC */
+  virtual bool putRspCharRaw(char c) override {
+    _outBuf.push_back(c);
     return true;
   }
   virtual int getRspCharRaw(bool blocking EMBDEBUG_ATTR_UNUSED) override {
@@ -44,6 +48,7 @@ protected:
 private:
   size_t _pos;
   const char *_buf;
+  std::string _outBuf;
 };
 
 class AbstractConnectionTest : public ::testing::TestWithParam<std::string> {
@@ -77,6 +82,29 @@ TEST_P(AbstractConnectionTest, GetPkt) {
   EXPECT_EQ(packetData(buf), pkt->getRawData());
 }
 
+// A break before a packet is consumed, but the packet is left intact.
+TEST_P(AbstractConnectionTest, BreakBeforePkt) {
+  std::string buf = "\x03" + GetParam();
+  tc->setBuf(buf.c_str());
+  EXPECT_TRUE(tc->haveBreak());
+  EXPECT_FALSE(tc->haveBreak());
+  bool success;
+  std::tie(success, *pkt) = tc->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(packetData(GetParam()), pkt->getRawData());
+}
+
+// Checking for a break must not consume the start of a packet.
+TEST_P(AbstractConnectionTest, NoBreakBeforePkt) {
+  std::string buf = GetParam();
+  tc->setBuf(buf.c_str());
+  EXPECT_FALSE(tc->haveBreak());
+  bool success;
+  std::tie(success, *pkt) = tc->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(packetData(buf), pkt->getRawData());
+}
+
 // Problem: the AbstractConnection keeps reading until it gets a good checksum.
 /*
 TEST_P(AbstractConnectionTest, BadChecksum) {
@@ -98,15 +126,193 @@ TEST_P(AbstractConnectionTest, DISABLED_BufferOverrun) {
   EXPECT_FALSE(success);
 }
 
-// PutPkt test is a work in progress.
-/*
 TEST_P(AbstractConnectionTest, PutPkt) {
-  std::string inbuf = GetParam();
-  const char* outbuf = calloc(sizeof(const char*) * 32);
-  tc->setBuf(outbuf);
-  EXPECT
-  free(outbuf);
-}*/
+  std::string buf = GetParam();
+  tc->setBuf("+");
+  EXPECT_TRUE(tc->putPkt(RspPacket(packetData(buf).c_str())));
+  EXPECT_EQ(buf, tc->getOutBuf());
+}
+
+// Reserved characters are escaped, and the checksum covers the escapes.
+TEST(AbstractConnectionEscapeTest, PutPktEscaped) {
+  TraceFlags flags;
+  TestConnection tc(&flags);
+  tc.setBuf("+");
+  EXPECT_TRUE(tc.putPkt(RspPacket("a$b#c*d}e")));
+  EXPECT_EQ("$a}\x04"
+            "b}\x03"
+            "c}\x0a"
+            "d}]e#51",
+            tc.getOutBuf());
+}
+
+// Runs of repeated chars are compressed, and the checksum covers what is
+// sent. Runs which would need a '#' or '$' as the count are split, and
+// chars which must be escaped are never compressed.
+TEST(AbstractConnectionEscapeTest, PutPktRunLength) {
+  TraceFlags flags;
+  TestConnection tc(&flags);
+  tc.setRunLengthEncoding(true);
+  tc.setBuf("+++");
+  EXPECT_TRUE(tc.putPkt(RspPacket("abbbbc0000000")));
+  EXPECT_TRUE(tc.putPkt(RspPacket(std::string(200, '0').c_str())));
+  EXPECT_TRUE(tc.putPkt(RspPacket("xx$$$$y")));
+  EXPECT_EQ("$ab* c0*\"0#1c"
+            "$0*~0*~0* #2a"
+            "$xx}\x04}\x04}\x04}\x04y#6d",
+            tc.getOutBuf());
+}
+
+// Over a reliable connection we don't wait for each packet to be
+// acknowledged. Input runs out until the acknowledgements are set.
+class ReliableTestConnection : public TestConnection {
+public:
+  ReliableTestConnection(TraceFlags *traceFlags) : TestConnection(traceFlags) {}
+
+  virtual bool isReliable() override { return true; }
+
+protected:
+  virtual int getRspCharRaw(bool blocking) override {
+    if (!haveInput)
+      return -1;
+    int ch = TestConnection::getRspCharRaw(blocking);
+    if (0 == ch) {
+      haveInput = false;
+      return -1;
+    }
+    return ch;
+  }
+
+public:
+  bool haveInput = false;
+};
+
+TEST(AbstractConnectionAckTest, PutPktPipelined) {
+  TraceFlags flags;
+  ReliableTestConnection tc(&flags);
+  EXPECT_TRUE(tc.putPkt(RspPacket("OK")));
+  EXPECT_TRUE(tc.putPkt(RspPacket("E01")));
+  EXPECT_EQ("$OK#9a$E01#a6", tc.getOutBuf());
+
+  // Late acknowledgements are consumed ahead of the next packet.
+  tc.setBuf("++$p20#d2");
+  tc.haveInput = true;
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("p20"), pkt.getRawData());
+}
+
+// A NAK has every packet not yet acknowledged sent again, in order.
+TEST(AbstractConnectionAckTest, NakResends) {
+  TraceFlags flags;
+  ReliableTestConnection tc(&flags);
+  EXPECT_TRUE(tc.putPkt(RspPacket("OK")));
+  EXPECT_TRUE(tc.putPkt(RspPacket("E01")));
+  EXPECT_TRUE(tc.putPkt(RspPacket("S05")));
+  tc.setBuf("+-");
+  tc.haveInput = true;
+  EXPECT_FALSE(tc.haveBreak());
+  EXPECT_EQ("$OK#9a$E01#a6$S05#b8$E01#a6$S05#b8", tc.getOutBuf());
+}
+
+// A connection delivering its input in chunks, as a socket would.
+class ChunkedTestConnection : public TestConnection {
+public:
+  ChunkedTestConnection(TraceFlags *traceFlags) : TestConnection(traceFlags) {}
+
+  std::vector<std::string> chunks;
+
+protected:
+  virtual int getRspBytesRaw(char *buf, std::size_t len,
+                             bool blocking EMBDEBUG_ATTR_UNUSED) override {
+    if (chunks.empty())
+      return -1;
+    std::string chunk = chunks.front();
+    chunks.erase(chunks.begin());
+    EXPECT_LE(chunk.size(), len);
+    ::memcpy(buf, chunk.data(), chunk.size());
+    return static_cast<int>(chunk.size());
+  }
+};
+
+// A packet taken from the receive buffer survives more input being read
+// before the next packet is asked for.
+TEST(AbstractConnectionInPlaceTest, PktSurvivesMoreInput) {
+  TraceFlags flags;
+  ChunkedTestConnection tc(&flags);
+  tc.chunks = {"$qOffsets#4b", "\x03"};
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_TRUE(tc.haveBreak());
+  EXPECT_EQ(std::string("qOffsets"), pkt.getRawData());
+  EXPECT_EQ("+", tc.getOutBuf());
+}
+
+// A packet split across several reads is put back together.
+TEST(AbstractConnectionInPlaceTest, SplitPkt) {
+  TraceFlags flags;
+  ChunkedTestConnection tc(&flags);
+  tc.chunks = {"$P20=7601", "1001000000", "00#", "ff$p20#d2"};
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("P20=7601100100000000"), pkt.getRawData());
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("p20"), pkt.getRawData());
+}
+
+// Input other than a break is left buffered for the next packet.
+TEST(AbstractConnectionInPlaceTest, NonBreakInputBuffered) {
+  TraceFlags flags;
+  ChunkedTestConnection tc(&flags);
+  EXPECT_FALSE(tc.hasBufferedInput());
+  tc.chunks = {"$qC#b4"};
+  EXPECT_FALSE(tc.haveBreak());
+  EXPECT_TRUE(tc.hasBufferedInput());
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+  EXPECT_FALSE(tc.hasBufferedInput());
+}
+
+// A connection which a new client can make, as with a socket.
+class ReconnectingTestConnection : public ChunkedTestConnection {
+public:
+  ReconnectingTestConnection(TraceFlags *traceFlags)
+      : ChunkedTestConnection(traceFlags) {}
+
+  virtual bool rspConnect() override {
+    resetClientState();
+    return true;
+  }
+};
+
+// Input left over from one client is not taken as coming from the next.
+TEST(AbstractConnectionReconnectTest, LeftoverInputDiscarded) {
+  TraceFlags flags;
+  ReconnectingTestConnection tc(&flags);
+  tc.chunks = {"$p20#d2\x03$qOffsets"};
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("p20"), pkt.getRawData());
+
+  EXPECT_TRUE(tc.rspConnect());
+  tc.chunks = {"$qC#b4"};
+  EXPECT_FALSE(tc.haveBreak());
+  std::tie(success, pkt) = tc.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+}
 
 INSTANTIATE_TEST_SUITE_P(SimplePackets, AbstractConnectionTest,
                          ::testing::Values("$Hc-1#09", "$qOffsets#4b",
@@ -1,12 +1,31 @@
+#include <chrono>
+#include <cstring>
 #include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 #include "AbstractConnection.h"
 #include "GdbServer.h"
+#include "Init.h"
+#include "RingConnection.h"
 #include "RspPacket.h"
 #include "StubTarget.h"
+#include "TargetLock.h"
 #include "embdebug/Compat.h"
 #include "embdebug/ITarget.h"
 
+#ifndef _WIN32
+#include "RspConnection.h"
+#include "StreamConnection.h"
+#include "UringConnection.h"
+#endif
+
 #include "gtest/gtest.h"
 
 using namespace EmbDebug;
@@ -57,9 +76,11 @@ public:
     RESET,
     CYCLE_COUNT,
     INSTR_COUNT,
+    TIME_STAMP,
     PREPARE,
     RESUME,
     WAIT,
+    HALT,
   };
   union ITargetCall {
     ITargetFunc func;
@@ -110,6 +131,11 @@ public:
       uint64_t outValue;
     } instrCountState;
 
+    struct TimeStampState {
+      ITargetFunc func;
+      double outValue;
+    } timeStampState;
+
     struct PrepareState {
       ITargetFunc func;
       ITarget::ResumeType inAction;
@@ -127,6 +153,11 @@ public:
       ITarget::WaitRes outWaitResult;
     } waitState;
 
+    struct HaltState {
+      ITargetFunc func;
+      bool outSuccess;
+    } haltState;
+
     ITargetCall(const ReadRegisterState &other) : readRegisterState(other) {}
     ITargetCall(const WriteRegisterState &other) : writeRegisterState(other) {}
     ITargetCall(const ReadState &other) : readState(other) {}
@@ -134,9 +165,11 @@ public:
     ITargetCall(const ResetState &other) : resetState(other) {}
     ITargetCall(const CycleCountState &other) : cycleCountState(other) {}
     ITargetCall(const InstrCountState &other) : instrCountState(other) {}
+    ITargetCall(const TimeStampState &other) : timeStampState(other) {}
     ITargetCall(const PrepareState &other) : prepareState(other) {}
     ITargetCall(const ResumeState &other) : resumeState(other) {}
     ITargetCall(const WaitState &other) : waitState(other) {}
+    ITargetCall(const HaltState &other) : haltState(other) {}
   };
 
   TraceTarget(const TraceFlags *traceFlags, int regCount, int regSize,
@@ -268,6 +301,12 @@ public:
     return call.instrCountState.outValue;
   }
 
+  double timeStamp() override {
+    auto &call = popAndVerifyCall(ITargetFunc::TIME_STAMP);
+    return call.timeStampState.outValue;
+  }
+
+  unsigned int getCurrentCpu() override { return 0; }
   void setCurrentCpu(unsigned int EMBDEBUG_ATTR_UNUSED index) override {}
 
   bool prepare(const std::vector<ResumeType> &actions) override {
@@ -292,6 +331,11 @@ public:
     return call.waitState.outWaitResult;
   }
 
+  bool halt(void) override {
+    auto &call = popAndVerifyCall(ITargetFunc::HALT);
+    return call.haltState.outSuccess;
+  }
+
   bool supportsTargetXML(void) override { return true; }
 
   const char *getTargetXML(ByteView name) override {
@@ -397,6 +441,20 @@ GdbServerTestCase testBasicRSPPackets[] = {
     {"$t#74+$vKill;1#6e+", "+$#00+$OK#9a", {}},
     {"$T#54+$vKill;1#6e+", "+$OK#9a+$OK#9a", {}},
     {"$L#4c+$vKill;1#6e+", "+$#00+$OK#9a", {}},
+    {"$QNonStop:1#8d+$QNonStop:0#8c+$vKill;1#6e+", "+$OK#9a+$OK#9a+$OK#9a",
+     {}},
+    {"$QNonStop:#5c+$QNonStop:01#bd+$vKill;1#6e+", "+$E01#a6+$E01#a6+$OK#9a",
+     {}},
+    // qRcmd,timeout 10 and qRcmd,cycle-timeout 100
+    {"$qRcmd,74696d656f7574203130#9e"
+     "+$qRcmd,6379636c652d74696d656f757420313030#dd+$vKill;1#6e+",
+     "+$OK#9a+$OK#9a+$OK#9a",
+     {}},
+    // qRcmd,timeout 10 x and qRcmd,real-timeout zz
+    {"$qRcmd,74696d656f75742031302078#6f"
+     "+$qRcmd,7265616c2d74696d656f7574207a7a#71+$vKill;1#6e+",
+     "+$E01#a6+$E01#a6+$OK#9a",
+     {}},
 };
 
 INSTANTIATE_TEST_SUITE_P(BasicRSPTest, GdbServerTest,
@@ -522,6 +580,105 @@ GdbServerTestCase testMemoryBinaryWrite = {
         }),
     },
 };
+// Binary reads are escaped as they are sent.
+GdbServerTestCase testMemoryBinaryRead = {
+    "$x124,2#6d+$x130,2#6a+$vKill;1#6e+",
+    "+$b\xbe\xef#0f+$b}\x03\x10#f2+$OK#9a",
+    {
+        TraceTarget::ITargetCall::ReadState({TraceTarget::ITargetFunc::READ,
+                                             0x124, 2,
+                                             (const uint8_t *)"\xbe\xef", 2}),
+        TraceTarget::ITargetCall::ReadState({TraceTarget::ITargetFunc::READ,
+                                             0x130, 2,
+                                             (const uint8_t *)"#\x10", 2}),
+    },
+};
+
+// A write the target only partly does is carried on from where it stopped,
+// and if the target can do no more, the write fails.
+GdbServerTestCase testMemoryWriteResumed = {
+    "$M200,4:11223344#0d+$vKill;1#6e+",
+    "+$OK#9a+$OK#9a",
+    {
+        TraceTarget::ITargetCall::WriteState({
+            TraceTarget::ITargetFunc::WRITE,
+            0x200,
+            (const uint8_t *)"\x11\x22\x33\x44",
+            4,
+            3,
+        }),
+        TraceTarget::ITargetCall::WriteState({
+            TraceTarget::ITargetFunc::WRITE,
+            0x203,
+            (const uint8_t *)"\x44",
+            1,
+            1,
+        }),
+    },
+};
+GdbServerTestCase testMemoryWritePartial = {
+    "$M200,4:11223344#0d+$vKill;1#6e+",
+    "+$E01#a6+$OK#9a",
+    {
+        TraceTarget::ITargetCall::WriteState({
+            TraceTarget::ITargetFunc::WRITE,
+            0x200,
+            (const uint8_t *)"\x11\x22\x33\x44",
+            4,
+            2,
+        }),
+        TraceTarget::ITargetCall::WriteState({
+            TraceTarget::ITargetFunc::WRITE,
+            0x202,
+            (const uint8_t *)"\x33\x44",
+            2,
+            0,
+        }),
+    },
+};
+
+// With the memory cache on, whole lines are read from the target and reads
+// are then served from them. Writes update the lines held.
+GdbServerTestCase testMemoryCached = {
+    // qRcmd,set mem-cache 16
+    "$qRcmd,736574206d656d2d6361636865203136#3b"
+    "+$m100,4#5e+$m10e,4#93+$M10f,1:aa#6d+$m10e,4#93+$vKill;1#6e+",
+    "+$OK#9a+$00010203#86+$0e0f1011#ee+$OK#9a+$0eaa1011#1a+$OK#9a",
+    {
+        TraceTarget::ITargetCall::ReadState(
+            {TraceTarget::ITargetFunc::READ, 0x100, 16,
+             (const uint8_t *)"\x00\x01\x02\x03\x04\x05\x06\x07"
+                              "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f",
+             16}),
+        TraceTarget::ITargetCall::ReadState(
+            {TraceTarget::ITargetFunc::READ, 0x110, 16,
+             (const uint8_t *)"\x10\x11\x12\x13\x14\x15\x16\x17"
+                              "\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f",
+             16}),
+        TraceTarget::ITargetCall::WriteState({
+            TraceTarget::ITargetFunc::WRITE,
+            0x10f,
+            (const uint8_t *)"\xaa",
+            1,
+            1,
+        }),
+    },
+};
+
+// Choosing the core which is already current keeps what the cache holds.
+GdbServerTestCase testMemoryCachedSameCore = {
+    // qRcmd,set mem-cache 16
+    "$qRcmd,736574206d656d2d6361636865203136#3b"
+    "+$m100,4#5e+$Hgp1.1#af+$m100,4#5e+$vKill;1#6e+",
+    "+$OK#9a+$00010203#86+$OK#9a+$00010203#86+$OK#9a",
+    {
+        TraceTarget::ITargetCall::ReadState(
+            {TraceTarget::ITargetFunc::READ, 0x100, 16,
+             (const uint8_t *)"\x00\x01\x02\x03\x04\x05\x06\x07"
+                              "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f",
+             16}),
+    },
+};
 
 INSTANTIATE_TEST_SUITE_P(
     MemoryReadWriteRSPTest, GdbServerTest,
@@ -531,7 +688,10 @@ INSTANTIATE_TEST_SUITE_P(
                       testMemoryInvalidWrite3, testMemoryInvalidWrite4,
                       testMemoryWriteBufferTooLong,
                       testMemoryWriteBufferTooShort, testMemoryRead,
-                      testMemoryWrite, testMemoryBinaryWrite));
+                      testMemoryWrite, testMemoryBinaryWrite,
+                      testMemoryWriteResumed, testMemoryWritePartial,
+                      testMemoryBinaryRead, testMemoryCached,
+                      testMemoryCachedSameCore));
 
 // Tests of vCont packets - stepping and continuing the target
 GdbServerTestCase testVContQuery = {
@@ -666,12 +826,70 @@ GdbServerTestCase testContinue2 = {
     },
 };
 
+// When a core stops, the memory around the PC and above the SP is read into
+// the cache, and reads of it are served from there.
+static const uint8_t zeroBytes[128] = {};
+GdbServerTestCase testStepPrefetch = {
+    /*reg count*/ 33,
+    /*reg size*/ 4,
+    // qRcmd,set prefetch 5 64 7 32
+    "$qRcmd,73657420707265666574636820352036342037203332#0e"
+    "+$vCont;s#b8+$m1000,4#8e+$m2008,4#97+$vKill;1#6e+",
+    "+$OK#9a+$S05#b8+$00000000#80+$00000000#80+$OK#9a",
+    {
+        TraceTarget::ITargetCall::PrepareState(
+            {TraceTarget::ITargetFunc::PREPARE, ITarget::ResumeType::STEP,
+             true}),
+        TraceTarget::ITargetCall::CycleCountState(
+            {TraceTarget::ITargetFunc::CYCLE_COUNT, 1234}),
+        TraceTarget::ITargetCall::ResumeState(
+            {TraceTarget::ITargetFunc::RESUME, true}),
+        TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                             ITarget::ResumeRes::STEPPED,
+                                             ITarget::WaitRes::EVENT_OCCURRED}),
+        TraceTarget::ITargetCall::ReadRegisterState(
+            {TraceTarget::ITargetFunc::READ_REGISTER, 5, 0x1000, 4}),
+        TraceTarget::ITargetCall::ReadRegisterState(
+            {TraceTarget::ITargetFunc::READ_REGISTER, 7, 0x2000, 4}),
+        TraceTarget::ITargetCall::ReadState(
+            {TraceTarget::ITargetFunc::READ, 0xfc0, 128, zeroBytes, 128}),
+        TraceTarget::ITargetCall::ReadState(
+            {TraceTarget::ITargetFunc::READ, 0x2000, 64, zeroBytes, 64}),
+    },
+};
+
+// Prefetching around a register the target doesn't have, or whose number
+// isn't known, is refused, and nothing is fetched when the core stops.
+GdbServerTestCase testStepPrefetchBadReg = {
+    /*reg count*/ 33,
+    /*reg size*/ 4,
+    // qRcmd,set prefetch 40 64 7 32
+    "$qRcmd,7365742070726566657463682034302036342037203332#70"
+    // qRcmd,set prefetch -1 64 7 32
+    "+$qRcmd,736574207072656665746368202d312036342037203332#a0"
+    "+$vCont;s#b8+$vKill;1#6e+",
+    "+$E02#a7+$E02#a7+$S05#b8+$OK#9a",
+    {
+        TraceTarget::ITargetCall::PrepareState(
+            {TraceTarget::ITargetFunc::PREPARE, ITarget::ResumeType::STEP,
+             true}),
+        TraceTarget::ITargetCall::CycleCountState(
+            {TraceTarget::ITargetFunc::CYCLE_COUNT, 1234}),
+        TraceTarget::ITargetCall::ResumeState(
+            {TraceTarget::ITargetFunc::RESUME, true}),
+        TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                             ITarget::ResumeRes::STEPPED,
+                                             ITarget::WaitRes::EVENT_OCCURRED}),
+    },
+};
+
 INSTANTIATE_TEST_SUITE_P(RSPVContTest, GdbServerTest,
                          ::testing::Values(testVContQuery, testVContStep1,
                                            testVContStep2, testVContContinue1,
                                            testVContContinue2, testStep1,
                                            testStep2, testContinue1,
-                                           testContinue2));
+                                           testContinue2, testStepPrefetch,
+                                           testStepPrefetchBadReg));
 
 // Tests of syscall handling and the associated RSP communication
 GdbServerTestCase testSyscallClose = {
@@ -882,6 +1100,14 @@ GdbServerTestCase testCmdInstrCount = {
             {TraceTarget::ITargetFunc::INSTR_COUNT, 439298888}),
     },
 };
+GdbServerTestCase testCmdTimeStamp = {
+    "$qRcmd,74696d657374616d70#3f++$vKill;1#6e+",  // timestamp
+    "+$O312e3233343537652b30360a#aa$OK#9a+$OK#9a", // 1.23457e+06\n
+    {
+        TraceTarget::ITargetCall::TimeStampState(
+            {TraceTarget::ITargetFunc::TIME_STAMP, 1234567.0}),
+    },
+};
 GdbServerTestCase testCmdEcho = {
     // qRcmd,echo Hello World\n
     "$qRcmd,6563686f2048656c6c6f20576f726c640a#6f+$vKill;1#6e+",
@@ -956,6 +1182,32 @@ GdbServerTestCase testCmdSetAndShowKillCoreOnExit = {
     "+$OK#9a",
     {},
 };
+GdbServerTestCase testCmdSetAndShowKeepState = {
+    // qRcmd,set keep-state
+    "$qRcmd,736574206b6565702d7374617465#42"
+    // qRcmd,show keep-state
+    "+$qRcmd,73686f77206b6565702d7374617465#e4"
+    // qRcmd,set keep-state off
+    "++$qRcmd,736574206b6565702d7374617465206f6666#18"
+    // qRcmd,show keep-state
+    "+$qRcmd,73686f77206b6565702d7374617465#e4"
+    "++$vKill;1#6e+",
+    // expected output rsp
+    "+$OK#9a"
+    // keep-state: ON\n
+    "+$O6b6565702d73746174653a204f4e0a#86$OK#9a"
+    "+$OK#9a"
+    // keep-state: OFF\n
+    "+$O6b6565702d73746174653a204f46460a#c1$OK#9a"
+    "+$OK#9a",
+    {},
+};
+GdbServerTestCase testCmdSetKeepStateInvalid = {
+    // qRcmd,set keep-state maybe
+    "$qRcmd,736574206b6565702d7374617465206d61796265#e8+$vKill;1#6e+",
+    "+$E02#a7+$OK#9a",
+    {},
+};
 GdbServerTestCase testCmdSetUnknownCommand = {
     // qRcmd,set unknown
     "$qRcmd,73657420756e6b6e6f776e#a4+$vKill;1#6e+",
@@ -973,11 +1225,13 @@ INSTANTIATE_TEST_SUITE_P(
     RSPCmdPacketTest, GdbServerTest,
     ::testing::Values(
         testCmdResetWarm, testCmdResetCold, testCmdExit, testCmdCycleCount,
-        testCmdInstrCount, testCmdEcho, testCmdSetDebugInvalidFlag,
-        testCmdShowDebugInvalidFlag, testCmdSetDebugFlagInvalidLevel,
-        testCmdSetAndShowDebugRspFlag, testCmdSetAndShowDebugConnFlag,
-        testCmdSetAndShowDebugDisasFlag, testCmdSetAndShowKillCoreOnExit,
-        testCmdSetUnknownCommand, testCmdShowUnknownCommand));
+        testCmdInstrCount, testCmdTimeStamp, testCmdEcho,
+        testCmdSetDebugInvalidFlag, testCmdShowDebugInvalidFlag,
+        testCmdSetDebugFlagInvalidLevel, testCmdSetAndShowDebugRspFlag,
+        testCmdSetAndShowDebugConnFlag, testCmdSetAndShowDebugDisasFlag,
+        testCmdSetAndShowKillCoreOnExit, testCmdSetAndShowKeepState,
+        testCmdSetKeepStateInvalid, testCmdSetUnknownCommand,
+        testCmdShowUnknownCommand));
 
 // Test of Target XML loading through ITarget
 GdbServerTestCase testXMLWhole = {
@@ -999,3 +1253,345 @@ GdbServerTestCase testXMLInvalidName = {
 INSTANTIATE_TEST_SUITE_P(RSPXmlPacketTest, GdbServerTest,
                          ::testing::Values(testXMLWhole, testXMLSplit,
                                            testXMLInvalidName));
+
+// A connection which the client can drop and make again, as with a socket.
+class ReconnectingConnection : public TraceConnection {
+public:
+  ReconnectingConnection(TraceFlags *traceFlags)
+      : TraceConnection(traceFlags), mConnected(true) {}
+
+  bool rspConnect() override {
+    mConnected = true;
+    return true;
+  }
+  void rspClose() override { mConnected = false; }
+  bool isConnected() override { return mConnected; }
+
+private:
+  bool mConnected;
+};
+
+// A core which has exited stays exited when GDB reconnects only if the
+// state of the cores is kept.
+class KeepStateTest : public ::testing::TestWithParam<bool> {};
+
+TEST_P(KeepStateTest, ExitedCoreAfterReconnect) {
+  bool keepState = GetParam();
+  TraceFlags flags;
+  ReconnectingConnection conn(&flags);
+  TraceTarget target(&flags, 1, 1, {});
+  GdbServer server(&conn, &target, &flags, RESET_ON_KILL);
+
+  server.setKeepState(keepState);
+  conn.setInBuf(
+      // qRcmd,set kill-core-on-exit
+      "$qRcmd,736574206b696c6c2d636f72652d6f6e2d65786974#84"
+      "+$vKill;1#6e+$qfThreadInfo#bb+$qRcmd,65786974#d7");
+  server.rspServer();
+
+  EXPECT_EQ(conn.getOutBuf(), keepState ? "+$OK#9a+$OK#9a+$l#6c+"
+                                        : "+$OK#9a+$OK#9a+$mp1.1#6d+");
+}
+
+INSTANTIATE_TEST_SUITE_P(KeepState, KeepStateTest,
+                         ::testing::Values(false, true));
+
+// A target shared with another session, which asks for the target the
+// first time our cores are found to be running.
+class ContendedTarget : public TraceTarget {
+public:
+  ContendedTarget(const TraceFlags *traceFlags, TargetLock *lock,
+                  std::vector<ITargetCall> targetTrace)
+      : TraceTarget(traceFlags, 1, 1, targetTrace), mLock(lock) {}
+
+  ~ContendedTarget() override {
+    if (mOtherSession.joinable())
+      mOtherSession.join();
+  }
+
+  WaitRes wait(std::vector<ResumeRes> &results) override {
+    WaitRes res = TraceTarget::wait(results);
+
+    if ((res == WaitRes::TIMEOUT) && !mOtherSession.joinable()) {
+      mOtherSession = std::thread([this] {
+        mLock->lock();
+        mLock->unlock();
+      });
+
+      while (!mLock->contended())
+        std::this_thread::yield();
+    }
+
+    return res;
+  }
+
+private:
+  TargetLock *mLock;
+  std::thread mOtherSession;
+};
+
+// When another session wants the target, our cores are halted and resumed
+// once it has had its turn. A core which stopped by itself just before the
+// halt has its stop reported, rather than being resumed.
+struct YieldTestCase {
+  std::string ExpectedOutStream;
+  std::vector<TraceTarget::ITargetCall> ITargetTrace;
+};
+
+class YieldTargetTest : public ::testing::TestWithParam<YieldTestCase> {};
+
+TEST_P(YieldTargetTest, YieldTarget) {
+  auto testCase = GetParam();
+  TraceFlags flags;
+  TraceConnection conn(&flags);
+  TargetLock lock;
+  ContendedTarget target(&flags, &lock, testCase.ITargetTrace);
+  GdbServer server(&conn, &target, &flags, EXIT_ON_KILL, {0}, &lock);
+
+  conn.setInBuf("$vCont;c#a8+$vKill;1#6e+");
+  server.rspServer();
+
+  EXPECT_EQ(conn.getOutBuf(), testCase.ExpectedOutStream);
+}
+
+static const std::vector<TraceTarget::ITargetCall> yieldStart = {
+    TraceTarget::ITargetCall::PrepareState(
+        {TraceTarget::ITargetFunc::PREPARE, ITarget::ResumeType::CONTINUE,
+         true}),
+    TraceTarget::ITargetCall::CycleCountState(
+        {TraceTarget::ITargetFunc::CYCLE_COUNT, 1234}),
+    TraceTarget::ITargetCall::PrepareState(
+        {TraceTarget::ITargetFunc::PREPARE, ITarget::ResumeType::CONTINUE,
+         true}),
+    TraceTarget::ITargetCall::ResumeState(
+        {TraceTarget::ITargetFunc::RESUME, true}),
+    TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                         ITarget::ResumeRes::NONE,
+                                         ITarget::WaitRes::TIMEOUT}),
+    TraceTarget::ITargetCall::HaltState({TraceTarget::ITargetFunc::HALT,
+                                         true}),
+};
+
+static std::vector<TraceTarget::ITargetCall>
+yieldTrace(std::vector<TraceTarget::ITargetCall> rest) {
+  std::vector<TraceTarget::ITargetCall> trace = yieldStart;
+  trace.insert(trace.end(), rest.begin(), rest.end());
+  return trace;
+}
+
+// Nothing stopped, so the target is handed over and our core resumed.
+YieldTestCase testYieldResumes = {
+    "+$S05#b8+$OK#9a",
+    yieldTrace({
+        TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                             ITarget::ResumeRes::NONE,
+                                             ITarget::WaitRes::TIMEOUT}),
+        TraceTarget::ITargetCall::PrepareState(
+            {TraceTarget::ITargetFunc::PREPARE, ITarget::ResumeType::CONTINUE,
+             true}),
+        TraceTarget::ITargetCall::ResumeState(
+            {TraceTarget::ITargetFunc::RESUME, true}),
+        TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                             ITarget::ResumeRes::INTERRUPTED,
+                                             ITarget::WaitRes::EVENT_OCCURRED}),
+    }),
+};
+
+// Our core hit a breakpoint before the halt, so the stop is reported and
+// the core is not resumed.
+YieldTestCase testYieldStopped = {
+    "+$S05#b8+$OK#9a",
+    yieldTrace({
+        TraceTarget::ITargetCall::WaitState({TraceTarget::ITargetFunc::WAIT,
+                                             ITarget::ResumeRes::INTERRUPTED,
+                                             ITarget::WaitRes::EVENT_OCCURRED}),
+    }),
+};
+
+INSTANTIATE_TEST_SUITE_P(YieldTarget, YieldTargetTest,
+                         ::testing::Values(testYieldResumes,
+                                           testYieldStopped));
+
+// A connection which lets another session take the target before handing
+// over the second packet received.
+class InterleavedConnection : public TraceConnection {
+public:
+  InterleavedConnection(TraceFlags *traceFlags, TargetLock *lock)
+      : TraceConnection(traceFlags), mLock(lock), mPktCount(0) {}
+
+  std::pair<bool, RspPacket> getPkt() override {
+    if (mLock && (++mPktCount == 2)) {
+      std::thread other([this] {
+        mLock->lock();
+        mLock->unlock();
+      });
+      other.join();
+    }
+
+    return TraceConnection::getPkt();
+  }
+
+private:
+  TargetLock *mLock;
+  unsigned int mPktCount;
+};
+
+// Memory held in the cache is kept from one request to the next, unless
+// another session has had the target in between.
+class SharedCacheTest : public ::testing::TestWithParam<bool> {};
+
+TEST_P(SharedCacheTest, SharedCache) {
+  bool otherSession = GetParam();
+  TraceFlags flags;
+  TargetLock lock;
+  InterleavedConnection conn(&flags, otherSession ? &lock : nullptr);
+  TraceTarget::ITargetCall read = TraceTarget::ITargetCall::ReadState(
+      {TraceTarget::ITargetFunc::READ, 0x100, 16,
+       (const uint8_t *)"\x00\x01\x02\x03\x04\x05\x06\x07"
+                        "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f",
+       16});
+  std::vector<TraceTarget::ITargetCall> trace = {read};
+
+  if (otherSession)
+    trace.push_back(read);
+
+  TraceTarget target(&flags, 1, 1, trace);
+  GdbServer server(&conn, &target, &flags, EXIT_ON_KILL, {0}, &lock);
+
+  conn.setInBuf(
+      // qRcmd,set mem-cache 16
+      "$qRcmd,736574206d656d2d6361636865203136#3b"
+      "+$m100,4#5e+$m100,4#5e+$vKill;1#6e+");
+  server.rspServer();
+
+  EXPECT_EQ(conn.getOutBuf(),
+            "+$OK#9a+$00010203#86+$00010203#86+$OK#9a");
+}
+
+INSTANTIATE_TEST_SUITE_P(SharedCache, SharedCacheTest,
+                         ::testing::Values(false, true));
+
+// The packet size offered to GDB is the one the connection prefers. Every
+// kind of connection we ship is reliable, so large packets are offered.
+class PacketSizeTest : public ::testing::Test {
+protected:
+  void SetUp() override { oldMaxPacketSize = RspPacket::getMaxPacketSize(); }
+  void TearDown() override { RspPacket::setMaxPacketSize(oldMaxPacketSize); }
+
+  // Serve GDB's request over the connection, until it kills the target
+  void serve(AbstractConnection &conn) {
+    TraceTarget target(&flags, 1, 1, {});
+    EXPECT_EQ(EXIT_SUCCESS, init(&target, &flags, &conn, 0));
+  }
+
+  static bool offersLargePackets(const std::string &reply) {
+    return reply.find("$PacketSize=20000;") != std::string::npos;
+  }
+
+  static const char *request() { return "$qSupported#37+$vKill;1#6e+"; }
+
+#ifndef _WIN32
+  // Play the part of GDB over a Unix domain socket
+  static std::string socketClient(const std::string &path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      return "";
+
+    // The server may not be listening yet
+    for (int i = 0; connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                            sizeof(addr)) != 0;
+         ++i) {
+      if (i == 500) {
+        close(fd);
+        return "";
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::string reply;
+    std::size_t len = strlen(request());
+    if (write(fd, request(), len) == static_cast<ssize_t>(len)) {
+      char buf[256];
+      ssize_t count;
+      while ((reply.find("$OK#9a") == std::string::npos) &&
+             ((count = read(fd, buf, sizeof(buf))) > 0))
+        reply.append(buf, static_cast<std::size_t>(count));
+    }
+
+    close(fd);
+    return reply;
+  }
+
+  void serveSocket(RspConnection &conn, const std::string &path) {
+    std::string reply;
+    std::thread gdb([&reply, &path] { reply = socketClient(path); });
+    serve(conn);
+    gdb.join();
+    EXPECT_TRUE(offersLargePackets(reply)) << reply;
+  }
+
+  std::string socketPath() {
+    return "/tmp/embdebug-test-pktsize." + std::to_string(getpid());
+  }
+#endif
+
+  TraceFlags flags;
+  std::size_t oldMaxPacketSize;
+};
+
+TEST_F(PacketSizeTest, Ring) {
+  RspRingChannel channel;
+  RingConnection conn(&channel, &flags);
+  std::size_t len = strlen(request());
+  ASSERT_EQ(len, channel.toServer.write(request(), len));
+  serve(conn);
+
+  char buf[256];
+  std::string reply(buf, channel.toClient.read(buf, sizeof(buf)));
+  EXPECT_TRUE(offersLargePackets(reply)) << reply;
+}
+
+#ifndef _WIN32
+TEST_F(PacketSizeTest, Stream) {
+  int toServer[2];
+  int toClient[2];
+  ASSERT_EQ(0, pipe(toServer));
+  ASSERT_EQ(0, pipe(toClient));
+
+  std::size_t len = strlen(request());
+  ASSERT_EQ(static_cast<ssize_t>(len), write(toServer[1], request(), len));
+  {
+    StreamConnection conn(&flags, toServer[0], toClient[1]);
+    serve(conn);
+  }
+  close(toClient[1]);
+
+  std::string reply;
+  char buf[256];
+  ssize_t count;
+  while ((count = read(toClient[0], buf, sizeof(buf))) > 0)
+    reply.append(buf, static_cast<std::size_t>(count));
+  EXPECT_TRUE(offersLargePackets(reply)) << reply;
+
+  close(toServer[0]);
+  close(toServer[1]);
+  close(toClient[0]);
+}
+
+TEST_F(PacketSizeTest, Socket) {
+  std::string path = socketPath();
+  RspConnection conn(path, &flags);
+  serveSocket(conn, path);
+}
+
+TEST_F(PacketSizeTest, Uring) {
+  std::string path = socketPath();
+  UringConnection conn(path, &flags);
+  serveSocket(conn, path);
+}
+#endif
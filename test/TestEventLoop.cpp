@@ -0,0 +1,50 @@
+#include <unistd.h>
+
+#include "EventLoop.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+class EventLoopTest : public ::testing::Test {
+protected:
+  void SetUp() override { ASSERT_EQ(0, pipe(fds)); }
+  void TearDown() override {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  int fds[2];
+};
+
+TEST_F(EventLoopTest, NothingToWaitFor) {
+  EventLoop loop;
+  EXPECT_EQ(-1, loop.wait(0));
+  EXPECT_FALSE(loop.add(-1));
+}
+
+TEST_F(EventLoopTest, TimesOutWhenNotReadable) {
+  EventLoop loop;
+  ASSERT_TRUE(loop.isValid());
+  EXPECT_TRUE(loop.add(fds[0]));
+  EXPECT_EQ(0, loop.wait(0));
+}
+
+TEST_F(EventLoopTest, WakesWhenReadable) {
+  EventLoop loop;
+  ASSERT_TRUE(loop.isValid());
+  EXPECT_TRUE(loop.add(fds[0]));
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  EXPECT_EQ(1, loop.wait(-1));
+}
+
+TEST_F(EventLoopTest, ClearStopsWatching) {
+  EventLoop loop;
+  ASSERT_TRUE(loop.isValid());
+  EXPECT_TRUE(loop.add(fds[0]));
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  loop.clear();
+  EXPECT_EQ(-1, loop.wait(0));
+  EXPECT_TRUE(loop.add(fds[0]));
+  EXPECT_EQ(1, loop.wait(0));
+}
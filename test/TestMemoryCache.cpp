@@ -0,0 +1,204 @@
+#include <cstring>
+#include <vector>
+
+#include "MemoryCache.h"
+#include "StubTarget.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+// A target with 256 bytes of memory, counting the calls made to read it.
+// Anything from 0x80 up is device registers, which may not be cached.
+class MemoryTarget : public StubTarget {
+public:
+  MemoryTarget() : StubTarget(nullptr), mReads(0), mMem(0x100) {
+    for (std::size_t i = 0; i < mMem.size(); i++)
+      mMem[i] = static_cast<uint8_t>(i);
+  }
+
+  std::size_t read(const uint_addr_t addr, uint8_t *buffer,
+                   const std::size_t size) override {
+    mReads++;
+    std::size_t n = (addr >= mMem.size()) ? 0 : mMem.size() - addr;
+    n = (n < size) ? n : size;
+    memcpy(buffer, &mMem[addr], n);
+    return n;
+  }
+
+  std::size_t write(const uint_addr_t addr, const uint8_t *buffer,
+                    const std::size_t size) override {
+    std::size_t n = (addr >= mMem.size()) ? 0 : mMem.size() - addr;
+    n = (n < size) ? n : size;
+    memcpy(&mMem[addr], buffer, n);
+    return n;
+  }
+
+  bool isCacheable(const uint_addr_t addr, const std::size_t size) override {
+    return addr + size <= 0x80;
+  }
+
+  int mReads;
+  std::vector<uint8_t> mMem;
+};
+
+TEST(MemoryCache, Disabled) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[4];
+
+  EXPECT_EQ(cache.read(0x10, buf, 4), 4u);
+  EXPECT_EQ(cache.read(0x10, buf, 4), 4u);
+  EXPECT_EQ(target.mReads, 2);
+}
+
+TEST(MemoryCache, LineSize) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+
+  EXPECT_FALSE(cache.setLineSize(12));
+  EXPECT_EQ(cache.getLineSize(), 0u);
+  EXPECT_TRUE(cache.setLineSize(16));
+  EXPECT_EQ(cache.getLineSize(), 16u);
+}
+
+// Missing neighbouring lines are read in one go, and then held.
+TEST(MemoryCache, ReadHeld) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[32];
+
+  cache.setLineSize(16);
+  EXPECT_EQ(cache.read(0x0c, buf, 8), 8u);
+  EXPECT_EQ(target.mReads, 1);
+  EXPECT_EQ(buf[0], 0x0c);
+  EXPECT_EQ(buf[7], 0x13);
+
+  EXPECT_EQ(cache.read(0x00, buf, 32), 32u);
+  EXPECT_EQ(target.mReads, 1);
+  EXPECT_EQ(buf[31], 0x1f);
+
+  cache.flush();
+  EXPECT_EQ(cache.read(0x00, buf, 1), 1u);
+  EXPECT_EQ(target.mReads, 2);
+}
+
+// Writes go to the target and update what is held.
+TEST(MemoryCache, WriteCoherent) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[16];
+  const uint8_t data[] = {0xaa, 0xbb, 0xcc};
+
+  cache.setLineSize(16);
+  EXPECT_EQ(cache.read(0x00, buf, 16), 16u);
+  EXPECT_EQ(cache.write(0x0e, data, 3), 3u);
+  EXPECT_EQ(target.mMem[0x10], 0xcc);
+
+  EXPECT_EQ(cache.read(0x08, buf, 16), 16u);
+  EXPECT_EQ(target.mReads, 2);
+  EXPECT_EQ(buf[5], 0x0d);
+  EXPECT_EQ(buf[6], 0xaa);
+  EXPECT_EQ(buf[7], 0xbb);
+  EXPECT_EQ(buf[8], 0xcc);
+  EXPECT_EQ(buf[9], 0x11);
+}
+
+// Memory which may not be cached is always read from the target.
+TEST(MemoryCache, Uncacheable) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[32];
+
+  cache.setLineSize(16);
+  EXPECT_EQ(cache.read(0x70, buf, 32), 32u);
+  EXPECT_EQ(target.mReads, 2);
+  EXPECT_EQ(buf[16], 0x80);
+
+  EXPECT_EQ(cache.read(0x70, buf, 32), 32u);
+  EXPECT_EQ(target.mReads, 3);
+  EXPECT_EQ(buf[31], 0x8f);
+}
+
+// A line the target can't read in full is not held, and a read past the end
+// of memory comes back short.
+TEST(MemoryCache, ReadShort) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[16];
+
+  target.mMem.resize(0x18);
+  cache.setLineSize(16);
+  EXPECT_EQ(cache.read(0x10, buf, 16), 8u);
+  EXPECT_EQ(cache.read(0x10, buf, 4), 4u);
+  EXPECT_EQ(target.mReads, 3);
+}
+
+// Prefetched lines are then held, but a prefetch the target can't read in
+// full leaves nothing marked unreadable.
+TEST(MemoryCache, Prefetch) {
+  MemoryTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[16];
+
+  cache.setLineSize(16);
+  cache.prefetch({MemoryCache::Range(0x04, 24)});
+  EXPECT_EQ(target.mReads, 1);
+  EXPECT_EQ(cache.read(0x00, buf, 16), 16u);
+  EXPECT_EQ(cache.read(0x10, buf, 16), 16u);
+  EXPECT_EQ(target.mReads, 1);
+
+  target.mMem.resize(0x28);
+  cache.prefetch({MemoryCache::Range(0x20, 16)});
+  EXPECT_EQ(target.mReads, 2);
+  target.mMem.resize(0x30);
+  EXPECT_EQ(cache.read(0x20, buf, 16), 16u);
+  EXPECT_EQ(cache.read(0x20, buf, 16), 16u);
+  EXPECT_EQ(target.mReads, 3);
+}
+
+// A target which can read several ranges in one call, counting the calls.
+class VectoredTarget : public MemoryTarget, public ITargetVectored {
+public:
+  VectoredTarget() : mReadvs(0) {}
+
+  ITargetVectored *getVectored(void) override { return this; }
+
+  bool readv(std::vector<ReadAccess> &accesses) override {
+    bool ok = true;
+    mReadvs++;
+
+    for (auto &access : accesses) {
+      access.count = read(access.addr, access.buffer, access.size);
+      ok = ok && (access.count == access.size);
+    }
+
+    return ok;
+  }
+
+  int mReadvs;
+};
+
+// All the lines missing for a prefetch are read in one call, with each run
+// of missing lines as one range, and lines shared by ranges read once.
+TEST(MemoryCache, Vectored) {
+  VectoredTarget target;
+  MemoryCache cache(&target);
+  uint8_t buf[16];
+
+  cache.setLineSize(16);
+  EXPECT_EQ(cache.read(0x10, buf, 16), 16u);
+  EXPECT_EQ(target.mReadvs, 1);
+  EXPECT_EQ(target.mReads, 1);
+
+  cache.prefetch({MemoryCache::Range(0x48, 8), MemoryCache::Range(0x00, 0x38),
+                  MemoryCache::Range(0x30, 8)});
+  EXPECT_EQ(target.mReadvs, 2);
+  EXPECT_EQ(target.mReads, 3);
+
+  EXPECT_EQ(cache.read(0x00, buf, 16), 16u);
+  EXPECT_EQ(cache.read(0x30, buf, 16), 16u);
+  EXPECT_EQ(cache.read(0x40, buf, 16), 16u);
+  EXPECT_EQ(target.mReadvs, 2);
+  EXPECT_EQ(buf[15], 0x4f);
+}
@@ -0,0 +1,78 @@
+#include "PacketParser.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+TEST(PacketParserTest, MemoryRequest) {
+  const char pkt[] = "M1000,4:deadBEEF";
+  PacketParser parser{ByteView(pkt)};
+  uint64_t addr;
+  std::size_t len;
+
+  EXPECT_TRUE(parser.expect('M'));
+  EXPECT_TRUE(parser.hex(addr));
+  EXPECT_TRUE(parser.expect(','));
+  EXPECT_TRUE(parser.hex(len));
+  EXPECT_TRUE(parser.expect(':'));
+  EXPECT_EQ(0x1000u, addr);
+  EXPECT_EQ(4u, len);
+  EXPECT_TRUE(parser.rest() == "deadBEEF");
+  EXPECT_TRUE(parser.atEnd());
+}
+
+// Failing to take a field leaves the cursor where it was.
+TEST(PacketParserTest, FailureLeavesCursor) {
+  PacketParser parser(ByteView("p:1"));
+  unsigned int regNum;
+
+  EXPECT_FALSE(parser.expect("pq"));
+  EXPECT_TRUE(parser.expect('p'));
+  EXPECT_FALSE(parser.hex(regNum));
+  EXPECT_FALSE(parser.expect(','));
+  EXPECT_TRUE(parser.expect(':'));
+  EXPECT_TRUE(parser.hex(regNum));
+  EXPECT_EQ(1u, regNum);
+  EXPECT_FALSE(parser.expect(':'));
+  EXPECT_FALSE(parser.skip(1));
+}
+
+// Numbers too big for the result are rejected.
+TEST(PacketParserTest, HexRange) {
+  uint64_t big;
+  uint8_t small;
+
+  PacketParser ok(ByteView("ffffffffffffffff"));
+  EXPECT_TRUE(ok.hex(big));
+  EXPECT_EQ(UINT64_MAX, big);
+
+  PacketParser tooBig(ByteView("10000000000000000"));
+  EXPECT_FALSE(tooBig.hex(big));
+
+  PacketParser byte(ByteView("100"));
+  EXPECT_FALSE(byte.hex(small));
+  EXPECT_TRUE(byte.expect('1'));
+}
+
+// A ptid runs up to the next ';', and fields need not be zero terminated.
+TEST(PacketParserTest, PtidAndFields) {
+  const char pkt[] = "vCont;s:p2.1;c:p3.-1;cX";
+  PacketParser parser(ByteView(pkt, sizeof(pkt) - 2));
+  Ptid ptid(1, 1);
+
+  EXPECT_TRUE(parser.expect("vCont;"));
+  EXPECT_TRUE(parser.field(':') == "s");
+  EXPECT_TRUE(parser.expect(':'));
+  EXPECT_TRUE(parser.ptid(ptid));
+  EXPECT_EQ(2, ptid.pid());
+  EXPECT_EQ(1, ptid.tid());
+  EXPECT_TRUE(parser.expect(';'));
+  EXPECT_TRUE(parser.field(':') == "c");
+  EXPECT_TRUE(parser.expect(':'));
+  EXPECT_TRUE(parser.ptid(ptid));
+  EXPECT_EQ(3, ptid.pid());
+  EXPECT_EQ(-1, ptid.tid()); // All threads
+  EXPECT_TRUE(parser.expect(';'));
+  EXPECT_TRUE(parser.field(';') == "c");
+  EXPECT_TRUE(parser.atEnd());
+}
@@ -0,0 +1,51 @@
+#include "PacketTable.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+typedef int (*Handler)();
+
+static int one() { return 1; }
+static int two() { return 2; }
+static int three() { return 3; }
+
+class PacketTableTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    table.addExact("qC", one);
+    table.addPrefix("qRcmd,", two);
+    table.addExact("vCont?", one);
+    table.addPrefix("vCont", two);
+    table.addPrefix("vCont;x", three);
+  }
+
+  int find(const char *pkt) {
+    Handler h = table.lookup(ByteView(pkt));
+    return (h != nullptr) ? h() : 0;
+  }
+
+  PacketTable<Handler> table;
+};
+
+TEST_F(PacketTableTest, Exact) {
+  EXPECT_EQ(1, find("qC"));
+  EXPECT_EQ(0, find("qCRC:0,4"));
+  EXPECT_EQ(0, find("q"));
+}
+
+TEST_F(PacketTableTest, Prefix) {
+  EXPECT_EQ(2, find("qRcmd,68656c70"));
+  EXPECT_EQ(2, find("qRcmd,"));
+  EXPECT_EQ(0, find("qRcmd"));
+  EXPECT_EQ(0, find("qSupported"));
+}
+
+// An exact match beats a prefix, and the longest prefix wins.
+TEST_F(PacketTableTest, BestMatch) {
+  EXPECT_EQ(1, find("vCont?"));
+  EXPECT_EQ(2, find("vCont"));
+  EXPECT_EQ(2, find("vCont;c"));
+  EXPECT_EQ(3, find("vCont;x:1"));
+  EXPECT_EQ(0, find("vKill;1"));
+}
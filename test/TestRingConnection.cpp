@@ -0,0 +1,96 @@
+#include <memory>
+#include <string>
+
+#include "RingConnection.h"
+#include "RspPacket.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+class RingConnectionTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    flags = new TraceFlags();
+    channel = new RspRingChannel();
+    conn = new RingConnection(channel, flags);
+  }
+  void TearDown() override {
+    delete conn;
+    delete channel;
+    delete flags;
+  }
+
+  void clientWrite(const std::string &str) {
+    ASSERT_EQ(str.size(), channel->toServer.write(str.data(), str.size()));
+  }
+
+  std::string clientRead() {
+    char buf[256];
+    std::size_t len = channel->toClient.read(buf, sizeof(buf));
+    return std::string(buf, len);
+  }
+
+  TraceFlags *flags;
+  RspRingChannel *channel;
+  RingConnection *conn;
+};
+
+TEST(RspRingTest, WrapAround) {
+  std::unique_ptr<RspRing> ring(new RspRing());
+  std::string chunk(RspRing::RING_SIZE / 3, 'x');
+  char buf[RspRing::RING_SIZE];
+
+  // Push enough through the ring that the indices wrap several times.
+  for (int i = 0; i < 10; i++) {
+    chunk[0] = static_cast<char>('a' + i);
+    ASSERT_EQ(chunk.size(), ring->write(chunk.data(), chunk.size()));
+    ASSERT_EQ(chunk.size(), ring->read(buf, sizeof(buf)));
+    EXPECT_EQ(chunk, std::string(buf, chunk.size()));
+  }
+  EXPECT_TRUE(ring->empty());
+}
+
+TEST(RspRingTest, Full) {
+  std::unique_ptr<RspRing> ring(new RspRing());
+  std::string big(RspRing::RING_SIZE + 10, 'y');
+  char c;
+
+  EXPECT_EQ(RspRing::RING_SIZE, ring->write(big.data(), big.size()));
+  EXPECT_EQ(0U, ring->write(big.data(), 1));
+  EXPECT_EQ(1U, ring->read(&c, 1));
+  EXPECT_EQ(1U, ring->write(big.data(), big.size()));
+}
+
+TEST_F(RingConnectionTest, GetPkt) {
+  clientWrite("$qC#b4");
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+  EXPECT_EQ("+", clientRead());
+}
+
+TEST_F(RingConnectionTest, PutPkt) {
+  clientWrite("+");
+  EXPECT_TRUE(conn->putPkt(RspPacket("OK")));
+  EXPECT_EQ("$OK#9a", clientRead());
+}
+
+TEST_F(RingConnectionTest, Break) {
+  EXPECT_FALSE(conn->haveBreak());
+  clientWrite("\x03");
+  EXPECT_TRUE(conn->haveBreak());
+  EXPECT_FALSE(conn->haveBreak());
+}
+
+TEST_F(RingConnectionTest, ClientClose) {
+  EXPECT_TRUE(conn->isConnected());
+  channel->closed = true;
+  EXPECT_FALSE(conn->isConnected());
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_FALSE(success);
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "RspConnection.h"
+#include "RspPacket.h"
+#include "TraceFlags.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+class RspConnectionUnixTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    socketPath = "/tmp/embdebug-test-rsp." + std::to_string(getpid());
+    unlink(socketPath.c_str());
+  }
+  void TearDown() override { unlink(socketPath.c_str()); }
+
+  struct sockaddr_un socketAddr() {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    socketPath.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    return addr;
+  }
+
+  bool exists() {
+    struct stat st;
+    return 0 == lstat(socketPath.c_str(), &st);
+  }
+
+  // Play the part of GDB: send a packet, and collect the ack and reply.
+  std::string client(const std::string &out, std::size_t replyLen) {
+    struct sockaddr_un addr = socketAddr();
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      return "";
+
+    // The server may not be listening yet
+    for (int i = 0; connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                            sizeof(addr)) != 0;
+         ++i) {
+      if (i == 500) {
+        close(fd);
+        return "";
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::string reply;
+    if (write(fd, out.data(), out.size()) ==
+        static_cast<ssize_t>(out.size())) {
+      char buf[64];
+      ssize_t len;
+      while ((reply.size() < replyLen) &&
+             ((len = read(fd, buf, sizeof(buf))) > 0))
+        reply.append(buf, static_cast<std::size_t>(len));
+    }
+
+    close(fd);
+    return reply;
+  }
+
+  // Send a packet to the server and check its reply comes back
+  void roundTrip(RspConnection &conn) {
+    std::string reply;
+    std::thread gdb(
+        [this, &reply] { reply = client("$qC#b4", strlen("+$OK#9a")); });
+
+    ASSERT_TRUE(conn.rspConnect());
+    ASSERT_TRUE(conn.isConnected());
+
+    bool success;
+    RspPacket pkt;
+    std::tie(success, pkt) = conn.getPkt();
+    EXPECT_TRUE(success);
+    EXPECT_EQ(std::string("qC"), pkt.getRawData());
+    EXPECT_TRUE(conn.putPkt(RspPacket::OK));
+
+    gdb.join();
+    conn.rspClose();
+    EXPECT_EQ(reply, "+$OK#9a");
+  }
+
+  std::string socketPath;
+};
+
+// Packets make the round trip over a Unix domain socket, which is removed
+// when we are done with it.
+TEST_F(RspConnectionUnixTest, RoundTrip) {
+  TraceFlags flags;
+  {
+    RspConnection conn(socketPath, &flags);
+    roundTrip(conn);
+    EXPECT_TRUE(exists());
+  }
+  EXPECT_FALSE(exists());
+}
+
+// A socket left behind by an earlier run is replaced.
+TEST_F(RspConnectionUnixTest, StaleSocketReplaced) {
+  struct sockaddr_un addr = socketAddr();
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, bind(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)));
+  close(fd);
+  ASSERT_TRUE(exists());
+
+  TraceFlags flags;
+  RspConnection conn(socketPath, &flags);
+  roundTrip(conn);
+}
+
+// Anything at the path other than a socket is left alone, both when we fail
+// to listen and when we are destroyed.
+TEST_F(RspConnectionUnixTest, OtherFileKept) {
+  std::ofstream(socketPath) << "precious" << std::endl;
+
+  TraceFlags flags;
+  {
+    RspConnection conn(socketPath, &flags);
+    EXPECT_FALSE(conn.rspConnect());
+    EXPECT_FALSE(conn.isConnected());
+  }
+
+  std::string contents;
+  std::ifstream(socketPath) >> contents;
+  EXPECT_EQ(contents, "precious");
+}
@@ -33,3 +33,61 @@ TEST_F(RspPacketTest, vContMessage) {
   EXPECT_EQ(std::string("vCont;c;C;s;S"), _pkt128->getRawData());
   EXPECT_EQ(13, _pkt128->getLen());
 }
+
+// Copies and moves keep the data, and its trailing zero byte.
+TEST_F(RspPacketTest, CopyAndMove) {
+  RspPacket orig("T05");
+  RspPacket copy(orig);
+  EXPECT_EQ(std::string("T05"), copy.getRawData());
+  EXPECT_EQ(3, copy.getLen());
+
+  RspPacket moved(std::move(copy));
+  EXPECT_EQ(std::string("T05"), moved.getRawData());
+  EXPECT_EQ(0, copy.getLen());
+  EXPECT_EQ(std::string(""), copy.getRawData());
+}
+
+// Packets too long to be held within the packet copy and move the same way.
+TEST_F(RspPacketTest, LongCopyAndMove) {
+  std::string big(100, 'x');
+  RspPacket orig(big.c_str());
+  RspPacket copy(orig);
+  RspPacket moved(std::move(orig));
+  EXPECT_EQ(big, copy.getRawData());
+  EXPECT_EQ(big, moved.getRawData());
+  EXPECT_EQ(0, orig.getLen());
+}
+
+TEST_F(RspPacketTest, ConstReplies) {
+  EXPECT_EQ(std::string("OK"), RspPacket::OK.getRawData());
+  EXPECT_EQ(0, RspPacket::EMPTY.getLen());
+  RspPacket copy(RspPacket::E01);
+  EXPECT_EQ(std::string("E01"), copy.getRawData());
+}
+
+TEST(RspPacketBuilderTest, Emitters) {
+  RspPacketBuilder builder;
+  builder += 'T';
+  builder.addHex(5, 2);
+  builder += "thread:p";
+  builder.addHex(0x1a);
+  builder += ".1;";
+  builder.addDec(1234567890123ULL);
+  builder += ';';
+  builder.addHex(0);
+  builder += ';';
+  builder.addHexStr("ON\n");
+  RspPacket pkt(builder);
+  EXPECT_EQ(std::string("T05thread:p1a.1;1234567890123;0;4f4e0a"),
+            pkt.getRawData());
+}
+
+// Builders grow beyond their own storage as needed.
+TEST(RspPacketBuilderTest, Grow) {
+  RspPacketBuilder builder;
+  for (int i = 0; i < 100; i++)
+    builder.addHex(0xffffffffffffffffULL);
+  RspPacket pkt(builder);
+  EXPECT_EQ(1600, pkt.getLen());
+  EXPECT_EQ(std::string(1600, 'f'), pkt.getRawData());
+}
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "RspPacket.h"
+#include "StreamConnection.h"
+#include "TraceFlags.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+// A stream connection over a pair of pipes, standing in for the pipes GDB
+// sets up with "target remote | embdebug --stdin".
+class StreamConnectionTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(0, pipe(toServer));
+    ASSERT_EQ(0, pipe(toClient));
+    conn = new StreamConnection(&flags, toServer[0], toClient[1]);
+  }
+  void TearDown() override {
+    delete conn;
+    for (int fd : {toServer[0], toServer[1], toClient[0], toClient[1]})
+      if (fd != -1)
+        close(fd);
+  }
+
+  void clientWrite(const std::string &str) {
+    ASSERT_EQ(static_cast<ssize_t>(str.size()),
+              write(toServer[1], str.data(), str.size()));
+  }
+
+  // Read until LEN chars have arrived, or the server's end is closed.
+  std::string clientRead(std::size_t len) {
+    std::string str;
+    char buf[4096];
+    ssize_t count;
+    while ((str.size() < len) &&
+           ((count = read(toClient[0], buf, sizeof(buf))) > 0))
+      str.append(buf, static_cast<std::size_t>(count));
+    return str;
+  }
+
+  TraceFlags flags;
+  int toServer[2];
+  int toClient[2];
+  StreamConnection *conn;
+};
+
+// Pipes are reliable, so large packets are offered.
+TEST_F(StreamConnectionTest, PreferredPacketSize) {
+  EXPECT_TRUE(conn->isReliable());
+  EXPECT_EQ(0x20000u, conn->preferredPacketSize());
+}
+
+// Several packets arriving in one read are each handed over in turn.
+TEST_F(StreamConnectionTest, SeveralPktsInOneRead) {
+  clientWrite("$qC#b4$p20#d2");
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("p20"), pkt.getRawData());
+  EXPECT_EQ("++", clientRead(2));
+}
+
+// A packet bigger than the pipe is sent in pieces, as the client drains
+// it. With the pipe non-blocking, each write takes only part of it.
+TEST_F(StreamConnectionTest, PartialWrites) {
+  std::size_t oldMax = RspPacket::getMaxPacketSize();
+  RspPacket::setMaxPacketSize(0x40000);
+
+  std::string data(0x30000, 'a');
+  for (std::size_t i = 0; i < data.size(); i += 7)
+    data[i] = 'b';
+  unsigned char checksum = 0;
+  for (char c : data)
+    checksum += static_cast<unsigned char>(c);
+  char trailer[4];
+  snprintf(trailer, sizeof(trailer), "#%02x", checksum);
+  std::string framed = "$" + data + trailer;
+
+  ASSERT_EQ(0, fcntl(toClient[1], F_SETFL, O_NONBLOCK));
+  std::string received;
+  std::thread client(
+      [this, &received, &framed] { received = clientRead(framed.size()); });
+
+  EXPECT_TRUE(conn->putPkt(RspPacket(data.c_str())));
+  client.join();
+  EXPECT_EQ(framed, received);
+
+  RspPacket::setMaxPacketSize(oldMax);
+}
+
+// The client closing its end ends the packet being read.
+TEST_F(StreamConnectionTest, EndOfFile) {
+  clientWrite("$qC#b4$p2");
+  close(toServer[1]);
+  toServer[1] = -1;
+
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+  std::tie(success, pkt) = conn->getPkt();
+  EXPECT_FALSE(success);
+}
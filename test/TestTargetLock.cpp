@@ -0,0 +1,62 @@
+#include <atomic>
+#include <thread>
+
+#include "TargetLock.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+TEST(TargetLockTest, NotContendedWhenAlone) {
+  TargetLock lock;
+  lock.lock();
+  EXPECT_FALSE(lock.contended());
+  lock.unlock();
+}
+
+// A session waiting for the lock is seen by the holder, and gets the lock
+// when the holder yields, even though the holder asks for it straight back.
+TEST(TargetLockTest, YieldToWaiter) {
+  TargetLock lock;
+  std::atomic<bool> waiterHadLock(false);
+
+  lock.lock();
+
+  std::thread waiter([&lock, &waiterHadLock] {
+    lock.lock();
+    waiterHadLock = true;
+    lock.unlock();
+  });
+
+  while (!lock.contended())
+    std::this_thread::yield();
+
+  EXPECT_FALSE(waiterHadLock);
+  lock.unlock();
+  lock.lock();
+  EXPECT_TRUE(waiterHadLock);
+  EXPECT_FALSE(lock.contended());
+  lock.unlock();
+
+  waiter.join();
+}
+
+// Tickets are handed out in turn, so a session can tell whether anyone else
+// has held the lock since it last did.
+TEST(TargetLockTest, TicketsShowOtherHolders) {
+  TargetLock lock;
+
+  unsigned long first = lock.lock();
+  lock.unlock();
+  EXPECT_EQ(lock.lock(), first + 1);
+  lock.unlock();
+
+  std::thread other([&lock] {
+    lock.lock();
+    lock.unlock();
+  });
+  other.join();
+
+  EXPECT_EQ(lock.lock(), first + 3);
+  lock.unlock();
+}
@@ -0,0 +1,325 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "RspPacket.h"
+#include "TraceFlags.h"
+#include "UringConnection.h"
+
+#include "gtest/gtest.h"
+
+using namespace EmbDebug;
+
+// A connection which has fallen back to plain socket calls, as when the
+// kernel lacks io_uring or the operations we use.
+class FallbackConnection : public UringConnection {
+public:
+  FallbackConnection(const std::string &socketPath, TraceFlags *traceFlags)
+      : UringConnection(socketPath, traceFlags) {
+    teardownRing();
+  }
+};
+
+class UringConnectionTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    socketPath = "/tmp/embdebug-test-uring." + std::to_string(getpid());
+  }
+
+  // Play the part of GDB: connect to the server, retrying until it is
+  // listening. Returns the socket, or -1 on failure.
+  static int connectClient(const std::string &path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      return -1;
+
+    // The server may not be listening yet
+    for (int i = 0; connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                            sizeof(addr)) != 0;
+         ++i) {
+      if (i == 500) {
+        close(fd);
+        return -1;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return fd;
+  }
+
+  // Read from the server until len chars have arrived, or it closes
+  static std::string readReply(int fd, std::size_t len) {
+    std::string reply;
+    std::vector<char> buf(65536);
+    ssize_t count;
+
+    while ((reply.size() < len) &&
+           ((count = read(fd, buf.data(), buf.size())) > 0))
+      reply.append(buf.data(), static_cast<std::size_t>(count));
+
+    return reply;
+  }
+
+  // Send a packet, and collect the ack and reply.
+  static std::string client(const std::string &path, const std::string &out,
+                            std::size_t replyLen) {
+    int fd = connectClient(path);
+    if (fd < 0)
+      return "";
+
+    std::string reply;
+    if (write(fd, out.data(), out.size()) == static_cast<ssize_t>(out.size()))
+      reply = readReply(fd, replyLen);
+
+    close(fd);
+    return reply;
+  }
+
+  // Packet data far larger than a socket buffer, so that sending it must
+  // wait for the client to read. None of its chars need escaping.
+  static std::string bigData(std::size_t len, std::size_t seed) {
+    std::string data(len, '\0');
+    for (std::size_t i = 0; i < len; i++)
+      data[i] = "0123456789abcdef"[(i + seed) * 7 % 16];
+
+    return data;
+  }
+
+  // How a packet appears on the wire
+  static std::string frame(const std::string &data) {
+    unsigned char checksum = 0;
+    for (char c : data)
+      checksum += static_cast<unsigned char>(c);
+
+    char tail[4];
+    snprintf(tail, sizeof(tail), "#%02x", checksum);
+    return "$" + data + tail;
+  }
+
+  // Send a packet to the server and check its reply comes back
+  void roundTrip(UringConnection &conn) {
+    std::string reply;
+    std::thread gdb([this, &reply] {
+      reply = client(socketPath, "$qC#b4", strlen("+$OK#9a"));
+    });
+
+    ASSERT_TRUE(conn.rspConnect());
+    ASSERT_TRUE(conn.isConnected());
+
+    bool success;
+    RspPacket pkt;
+    std::tie(success, pkt) = conn.getPkt();
+    EXPECT_TRUE(success);
+    EXPECT_EQ(std::string("qC"), pkt.getRawData());
+    EXPECT_TRUE(conn.putPkt(RspPacket::OK));
+
+    gdb.join();
+    conn.rspClose();
+    EXPECT_EQ(reply, "+$OK#9a");
+  }
+
+  std::string socketPath;
+};
+
+// A packet makes the round trip through the ring.
+TEST_F(UringConnectionTest, RoundTrip) {
+  TraceFlags flags;
+  UringConnection conn(socketPath, &flags);
+  if (!conn.usingUring())
+    GTEST_SKIP() << "io_uring is not available";
+
+  roundTrip(conn);
+}
+
+// Having fallen back, the connection behaves as a plain socket.
+TEST_F(UringConnectionTest, FallbackRoundTrip) {
+  TraceFlags flags;
+  FallbackConnection conn(socketPath, &flags);
+  EXPECT_FALSE(conn.usingUring());
+  roundTrip(conn);
+}
+
+// Replies too large for the socket buffer are queued without waiting for
+// the client, the second behind the first while it is still being sent,
+// and both arrive intact once the client reads.
+TEST_F(UringConnectionTest, QueuedBehindSend) {
+  TraceFlags flags;
+  UringConnection conn(socketPath, &flags);
+  if (!conn.usingUring())
+    GTEST_SKIP() << "io_uring is not available";
+
+  std::string first = bigData(512 * 1024, 0);
+  std::string second = bigData(512 * 1024, 3);
+  std::string expected = frame(first) + frame(second);
+  std::atomic<bool> reading(false);
+  std::string reply;
+
+  std::thread gdb([&] {
+    int fd = connectClient(socketPath);
+    if (fd < 0)
+      return;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    reading = true;
+    reply = readReply(fd, expected.size());
+
+    // Give the server something to wait for while it finishes sending.
+    if (write(fd, "$qC#b4", 6) != 6)
+      reply.clear();
+
+    close(fd);
+  });
+
+  ASSERT_TRUE(conn.rspConnect());
+  conn.setNoAckMode(true);
+  EXPECT_TRUE(conn.putPkt(RspPacket(first.data(), first.size())));
+  EXPECT_TRUE(conn.putPkt(RspPacket(second.data(), second.size())));
+  EXPECT_FALSE(reading);
+
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+
+  conn.rspClose();
+  gdb.join();
+  EXPECT_EQ(expected.size(), reply.size());
+  EXPECT_TRUE(expected == reply);
+}
+
+// Once more than SEND_HIGH_WATER chars are queued, sending waits for the
+// client to catch up.
+TEST_F(UringConnectionTest, BackPressure) {
+  TraceFlags flags;
+  UringConnection conn(socketPath, &flags);
+  if (!conn.usingUring())
+    GTEST_SKIP() << "io_uring is not available";
+
+  std::vector<std::string> data;
+  std::string expected;
+  for (std::size_t i = 0; i < 3; i++) {
+    data.push_back(bigData(1024 * 1024, i));
+    expected += frame(data.back());
+  }
+
+  std::atomic<bool> reading(false);
+  std::string reply;
+
+  std::thread gdb([&] {
+    int fd = connectClient(socketPath);
+    if (fd < 0)
+      return;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    reading = true;
+    reply = readReply(fd, expected.size());
+    close(fd);
+  });
+
+  ASSERT_TRUE(conn.rspConnect());
+  conn.setNoAckMode(true);
+
+  // The first is in flight and the second queued, without waiting.
+  EXPECT_TRUE(conn.putPkt(RspPacket(data[0].data(), data[0].size())));
+  EXPECT_TRUE(conn.putPkt(RspPacket(data[1].data(), data[1].size())));
+  EXPECT_FALSE(reading);
+
+  // The queue is now over the high water mark, so this must wait.
+  EXPECT_TRUE(conn.putPkt(RspPacket(data[2].data(), data[2].size())));
+  EXPECT_TRUE(reading);
+
+  conn.rspClose();
+  gdb.join();
+  EXPECT_EQ(expected.size(), reply.size());
+  EXPECT_TRUE(expected == reply);
+}
+
+// The file descriptor for the event loop becomes readable when data
+// arrives, although the data itself goes to the posted receive.
+TEST_F(UringConnectionTest, EventFdReadable) {
+  TraceFlags flags;
+  UringConnection conn(socketPath, &flags);
+  if (!conn.usingUring())
+    GTEST_SKIP() << "io_uring is not available";
+
+  std::string reply;
+  std::thread gdb([&] {
+    int fd = connectClient(socketPath);
+    if (fd < 0)
+      return;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if (write(fd, "$qC#b4", 6) == 6)
+      reply = readReply(fd, strlen("+$OK#9a"));
+
+    close(fd);
+  });
+
+  ASSERT_TRUE(conn.rspConnect());
+  int fd = conn.getFd();
+  ASSERT_NE(-1, fd);
+  EXPECT_NE(conn.RspConnection::getFd(), fd);
+
+  struct pollfd pfd = {fd, POLLIN, 0};
+  EXPECT_EQ(0, poll(&pfd, 1, 0));
+  EXPECT_EQ(1, poll(&pfd, 1, 5000));
+  EXPECT_TRUE(pfd.revents & POLLIN);
+
+  bool success;
+  RspPacket pkt;
+  std::tie(success, pkt) = conn.getPkt();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(std::string("qC"), pkt.getRawData());
+  EXPECT_TRUE(conn.putPkt(RspPacket::OK));
+
+  conn.rspClose();
+  gdb.join();
+  EXPECT_EQ(reply, "+$OK#9a");
+}
+
+// Closing sends whatever is still queued before shutting the socket down,
+// so the client sees the whole reply and then the end of file.
+TEST_F(UringConnectionTest, CloseDrainsSend) {
+  TraceFlags flags;
+  UringConnection conn(socketPath, &flags);
+  if (!conn.usingUring())
+    GTEST_SKIP() << "io_uring is not available";
+
+  std::string data = bigData(2 * 1024 * 1024, 5);
+  std::string expected = frame(data);
+  std::string reply;
+
+  std::thread gdb([&] {
+    int fd = connectClient(socketPath);
+    if (fd < 0)
+      return;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    reply = readReply(fd, std::string::npos);
+    close(fd);
+  });
+
+  ASSERT_TRUE(conn.rspConnect());
+  conn.setNoAckMode(true);
+  EXPECT_TRUE(conn.putPkt(RspPacket(data.data(), data.size())));
+
+  conn.rspClose();
+  gdb.join();
+  EXPECT_EQ(expected.size(), reply.size());
+  EXPECT_TRUE(expected == reply);
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "Utils.h"
 
 #include "gtest/gtest.h"
@@ -82,3 +86,150 @@ TEST(hex2CharMultipleDigits, ReturnsNullChar) {
   for (uint8_t d = 0; d <= 239; d++)
     EXPECT_DEATH(Utils::hex2Char(d + 16), "d <= 0xf");
 }
+
+// Every version of the bulk hex conversions the host can run must match the
+// scalar versions for every length, so that both the vector blocks and the
+// tails are covered.
+TEST(hexEncodeBulk, MatchesScalar) {
+  std::vector<uint8_t> bytes(200);
+  for (std::size_t i = 0; i < bytes.size(); i++)
+    bytes[i] = static_cast<uint8_t>(i * 37 + 11);
+
+  for (const Utils::detail::HexKernels &k : Utils::detail::hexKernels())
+    for (std::size_t len = 0; len <= 130; len++) {
+      std::string bulk(len * 2, '\0');
+      std::string scalar(len * 2, '\0');
+      k.encode(&bulk[0], bytes.data() + 3, len);
+      Utils::hexEncodeScalar(&scalar[0], bytes.data() + 3, len);
+      ASSERT_EQ(scalar, bulk) << k.name << " length " << len;
+    }
+}
+
+TEST(hexDecodeBulk, RoundTrip) {
+  std::vector<uint8_t> bytes(256);
+  for (std::size_t i = 0; i < bytes.size(); i++)
+    bytes[i] = static_cast<uint8_t>(i);
+
+  std::string hex(bytes.size() * 2, '\0');
+  Utils::hexEncodeScalar(&hex[0], bytes.data(), bytes.size());
+
+  for (const Utils::detail::HexKernels &k : Utils::detail::hexKernels())
+    for (std::size_t len = 0; len <= bytes.size(); len++) {
+      std::vector<uint8_t> out(len);
+      ASSERT_TRUE(k.decode(out.data(), hex.data(), len))
+          << k.name << " length " << len;
+      ASSERT_TRUE(std::equal(out.begin(), out.end(), bytes.begin()))
+          << k.name << " length " << len;
+    }
+}
+
+TEST(hexDecodeBulk, UpperCase) {
+  std::string hex = "0123456789ABCDEFabcdef0123456789ABCDEFabcdef";
+  std::vector<uint8_t> scalar(hex.size() / 2);
+  ASSERT_TRUE(Utils::hexDecodeScalar(scalar.data(), hex.data(), scalar.size()));
+
+  for (const Utils::detail::HexKernels &k : Utils::detail::hexKernels()) {
+    std::vector<uint8_t> bulk(hex.size() / 2);
+    ASSERT_TRUE(k.decode(bulk.data(), hex.data(), bulk.size())) << k.name;
+    EXPECT_EQ(scalar, bulk) << k.name;
+  }
+}
+
+// A bad digit anywhere is caught, including chars either side of the digit
+// ranges and chars with the top bit set.
+TEST(hexDecodeBulk, BadDigit) {
+  const char bad[] = {'/', ':', '@', 'G', '`', 'g', ' ', '\xb0', '\xc1'};
+  std::string hex(128, 'a');
+  std::vector<uint8_t> out(hex.size() / 2);
+
+  for (const Utils::detail::HexKernels &k : Utils::detail::hexKernels())
+    for (char c : bad)
+      for (std::size_t pos = 0; pos < hex.size(); pos++) {
+        std::string s = hex;
+        s[pos] = c;
+        ASSERT_FALSE(Utils::hexDecodeScalar(out.data(), s.data(), out.size()));
+        ASSERT_FALSE(k.decode(out.data(), s.data(), out.size()))
+            << k.name << " char " << static_cast<int>(c) << " at " << pos;
+      }
+}
+
+// Scanning must stop at the first special char wherever it falls, and sum
+// exactly the chars before it, including chars with the top bit set. Every
+// version the host can run must agree with the scalar one.
+TEST(rspScan, StopsAndSums) {
+  std::string data(100, '\0');
+  for (std::size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<char>('a' + i * 131 % 200);
+
+  std::vector<Utils::detail::HexKernels> all = Utils::detail::hexKernels();
+  const Utils::detail::HexKernels &scalar = all.front();
+
+  for (const Utils::detail::HexKernels &k : all)
+    for (char stop : {'$', '#', '*', '}'})
+      for (std::size_t pos = 0; pos <= data.size(); pos++) {
+        std::string s = data;
+        unsigned char expected = 7;
+
+        for (std::size_t i = 0; i < s.size(); i++)
+          if (('$' == s[i]) || ('#' == s[i]) || ('*' == s[i]) || ('}' == s[i]))
+            s[i] = 'x';
+
+        if (pos < s.size())
+          s[pos] = stop;
+
+        for (std::size_t i = 0; i < pos && i < s.size(); i++)
+          expected += static_cast<unsigned char>(s[i]);
+
+        unsigned char checksum = 7;
+        unsigned char scalarSum = 7;
+        ASSERT_EQ(std::min(pos, s.size()),
+                  scalar.scanEscape(s.data(), s.size(), scalarSum));
+        ASSERT_EQ(expected, scalarSum) << "stop at " << pos;
+        ASSERT_EQ(std::min(pos, s.size()),
+                  k.scanEscape(s.data(), s.size(), checksum))
+            << k.name;
+        ASSERT_EQ(expected, checksum) << k.name << " stop at " << pos;
+
+        // Only the end of a packet stops a received packet scan.
+        std::size_t end =
+            (('$' == stop) || ('#' == stop)) ? std::min(pos, s.size())
+                                             : s.size();
+        checksum = 7;
+        scalarSum = 7;
+        ASSERT_EQ(end, scalar.scanPacket(s.data(), s.size(), scalarSum));
+        ASSERT_EQ(end, k.scanPacket(s.data(), s.size(), checksum)) << k.name;
+        ASSERT_EQ(scalarSum, checksum) << k.name << " stop at " << pos;
+      }
+}
+
+// The versions used by default are the last the host can run.
+TEST(hexKernels, DefaultIsLast) {
+  std::vector<Utils::detail::HexKernels> all = Utils::detail::hexKernels();
+  ASSERT_FALSE(all.empty());
+  EXPECT_STREQ("scalar", all.front().name);
+
+  uint8_t bytes[40];
+  for (std::size_t i = 0; i < sizeof(bytes); i++)
+    bytes[i] = static_cast<uint8_t>(i * 7);
+
+  std::string bulk(sizeof(bytes) * 2, '\0');
+  std::string last(sizeof(bytes) * 2, '\0');
+  Utils::hexEncode(&bulk[0], bytes, sizeof(bytes));
+  all.back().encode(&last[0], bytes, sizeof(bytes));
+  EXPECT_EQ(last, bulk);
+
+  std::string s(70, 'q');
+  s[50] = '*';
+  unsigned char checksum = 0;
+  unsigned char lastSum = 0;
+  EXPECT_EQ(all.back().scanEscape(s.data(), s.size(), lastSum),
+            Utils::rspScanEscape(s.data(), s.size(), checksum));
+  EXPECT_EQ(lastSum, checksum);
+}
+
+TEST(rspUnescape, RunsAndEscapes) {
+  std::string s = "ab}\x03"
+                  "cdefghijklmnopqrstuvwxyz}]}\x0a}\x04";
+  std::size_t len = Utils::rspUnescape(&s[0], s.size());
+  EXPECT_EQ(std::string("ab#cdefghijklmnopqrstuvwxyz}*$"), s.substr(0, len));
+}
@@ -10,6 +10,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -80,10 +82,11 @@ ITarget *load_target_so(string soname, TraceFlags *traceFlags) {
     cerr << "Failed to look up ITargetVersion: " << dlerror() << endl;
     exit(EXIT_FAILURE);
   }
-  if (api_version() != ITarget::CURRENT_API_VERSION) {
+  if ((api_version() < ITarget::MIN_API_VERSION) ||
+      (api_version() > ITarget::CURRENT_API_VERSION)) {
     cerr << "Incompatible ITarget versions: Target declared version "
-         << api_version() << ", expected " << ITarget::CURRENT_API_VERSION
-         << endl;
+         << api_version() << ", expected " << ITarget::MIN_API_VERSION
+         << " to " << ITarget::CURRENT_API_VERSION << endl;
     exit(EXIT_FAILURE);
   }
   create_target_func create_target =
@@ -111,10 +114,11 @@ ITarget *load_target_dll(string dllname, TraceFlags *traceFlags) {
     cerr << "Failed to look up ITargetVersion." << endl;
     exit(EXIT_FAILURE);
   }
-  if (api_version() != ITarget::CURRENT_API_VERSION) {
+  if ((api_version() < ITarget::MIN_API_VERSION) ||
+      (api_version() > ITarget::CURRENT_API_VERSION)) {
     cerr << "Incompatible ITarget versions: Target declared version "
-         << api_version() << ", expected " << ITarget::CURRENT_API_VERSION
-         << endl;
+         << api_version() << ", expected " << ITarget::MIN_API_VERSION
+         << " to " << ITarget::CURRENT_API_VERSION << endl;
     exit(EXIT_FAILURE);
   }
   create_target_func create_target =
@@ -133,7 +137,9 @@ int main(int argc, char *argv[]) {
   TraceFlags traceFlags;
   bool withLockstep;
   int rspPort = 0;
-  std::size_t rspBufSize = 10000;
+  std::size_t rspBufSize = 0; // Chosen to suit the connection
+  std::vector<std::pair<unsigned long, unsigned long>> sessionRanges;
+  ServerOptions serverOptions;
 
   cxxopts::Options options("embdebug", "GDBServer");
   options.add_options()("q,silent",
@@ -149,12 +155,51 @@ int main(int argc, char *argv[]) {
       "l,lockstep", "Enable lockstep debugging",
       cxxopts::value<bool>(withLockstep)->default_value("false"));
   options.add_options()("bufsize",
-                        "Set RSP buffer size in bytes (default 10,000)",
+                        "Set RSP buffer size in bytes (default chosen to "
+                        "suit the connection)",
                         cxxopts::value<string>(), "<size>");
   options.add_options()("soname", "Shared object containing model",
                         cxxopts::value<string>(soName), "<shared object>");
   options.add_options()("rsp-port", "Port to listen on",
                         cxxopts::value<string>(), "<num>");
+  options.add_options()(
+      "rsp-socket", "Unix domain socket to listen on instead of a port",
+      cxxopts::value<string>(serverOptions.rspSocketPath), "<path>");
+  options.add_options()(
+      "keep-state", "Keep the state of the cores when GDB reconnects",
+      cxxopts::value<bool>(serverOptions.keepState)->default_value("false"));
+  options.add_options()(
+      "io-uring", "Use io_uring for socket traffic, where available",
+      cxxopts::value<bool>(serverOptions.useIoUring)
+          ->default_value("false"));
+  options.add_options()(
+      "rle", "Run length encode repeated characters in replies to GDB",
+      cxxopts::value<bool>(serverOptions.useRle)->default_value("false"));
+  options.add_options()("mem-cache",
+                        "Cache target memory in lines of this many bytes "
+                        "while the cores are halted",
+                        cxxopts::value<string>(), "<line size>");
+  options.add_options()("prefetch-pc",
+                        "Fetch this many bytes around the PC when a core "
+                        "stops",
+                        cxxopts::value<string>(), "<bytes>");
+  options.add_options()("prefetch-sp",
+                        "Fetch this many bytes above the SP when a core "
+                        "stops",
+                        cxxopts::value<string>(), "<bytes>");
+  options.add_options()("pc-regnum",
+                        "GDB's number for the PC register (needed by "
+                        "--prefetch-pc)",
+                        cxxopts::value<string>(), "<num>");
+  options.add_options()("sp-regnum",
+                        "GDB's number for the SP register (needed by "
+                        "--prefetch-sp)",
+                        cxxopts::value<string>(), "<num>");
+  options.add_options()("session",
+                        "Serve a separate GDB session for a range of cores, "
+                        "on the next port (may be repeated)",
+                        cxxopts::value<std::vector<std::string>>(),
+                        "<first>[-<last>]");
 
   options.positional_help("[rsp-port]");
   options.parse_positional({"rsp-port"});
@@ -195,7 +240,84 @@ int main(int argc, char *argv[]) {
       }
     }
 
-    if (result.count("rsp-port")) {
+    if (result.count("mem-cache") != 0) {
+      string token = result["mem-cache"].as<std::string>();
+      try {
+        serverOptions.memCacheLine = std::stoul(token, nullptr, 0);
+      } catch (std::logic_error &) {
+        cerr << "ERROR: failed to parse memory cache line size from: "
+             << token << endl;
+        return EXIT_FAILURE;
+      }
+
+      std::size_t lineSize = serverOptions.memCacheLine;
+      if ((lineSize == 0) || ((lineSize & (lineSize - 1)) != 0)) {
+        cerr << "ERROR: memory cache line size must be a power of two: "
+             << token << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (result.count("prefetch-pc") != 0) {
+      string token = result["prefetch-pc"].as<std::string>();
+      try {
+        serverOptions.prefetchPc = std::stoul(token, nullptr, 0);
+      } catch (std::logic_error &) {
+        cerr << "ERROR: failed to parse PC prefetch size from: " << token
+             << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (result.count("prefetch-sp") != 0) {
+      string token = result["prefetch-sp"].as<std::string>();
+      try {
+        serverOptions.prefetchSp = std::stoul(token, nullptr, 0);
+      } catch (std::logic_error &) {
+        cerr << "ERROR: failed to parse SP prefetch size from: " << token
+             << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (result.count("pc-regnum") != 0) {
+      string token = result["pc-regnum"].as<std::string>();
+      try {
+        serverOptions.pcRegnum = std::stoi(token, nullptr, 0);
+      } catch (std::logic_error &) {
+        cerr << "ERROR: failed to parse PC register number from: " << token
+             << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (result.count("sp-regnum") != 0) {
+      string token = result["sp-regnum"].as<std::string>();
+      try {
+        serverOptions.spRegnum = std::stoi(token, nullptr, 0);
+      } catch (std::logic_error &) {
+        cerr << "ERROR: failed to parse SP register number from: " << token
+             << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    // Register numbers depend on the architecture, so there is no default.
+    if (((serverOptions.prefetchPc != 0) && (serverOptions.pcRegnum < 0)) ||
+        ((serverOptions.prefetchSp != 0) && (serverOptions.spRegnum < 0))) {
+      cerr << "ERROR: --prefetch-pc needs --pc-regnum, and --prefetch-sp "
+              "needs --sp-regnum"
+           << endl;
+      return EXIT_FAILURE;
+    }
+
+    if (result.count("rsp-socket")) {
+      if (result.count("rsp-port") || from_stdin) {
+        cerr << "ERROR: --rsp-socket cannot be used with --rsp-port or --stdin"
+             << endl;
+        return EXIT_FAILURE;
+      }
+    } else if (result.count("rsp-port")) {
       string token = result["rsp-port"].as<std::string>();
       // In GDB when connecting to a local gdbserver over a socket the
       // syntax is 'target remote :PORT'.  Sometimes users then try to
@@ -219,6 +341,55 @@ int main(int argc, char *argv[]) {
       cerr << "NOTE: No port number found - using ephemeral port" << endl;
     }
 
+    if (result.count("session")) {
+      if (from_stdin) {
+        cerr << "ERROR: --session cannot be used with --stdin" << endl;
+        return EXIT_FAILURE;
+      }
+
+      // The sessions' ports follow on from the first, so it must be known
+      // for anyone to find them.
+      if (serverOptions.rspSocketPath.empty() && (rspPort == 0)) {
+        cerr << "ERROR: --session needs --rsp-port or --rsp-socket" << endl;
+        return EXIT_FAILURE;
+      }
+
+      // Each session is given a contiguous range of cores
+      for (auto range : result["session"].as<std::vector<std::string>>()) {
+        unsigned long first;
+        unsigned long last;
+
+        try {
+          std::size_t pos;
+          first = std::stoul(range, &pos);
+          last = first;
+
+          if (pos < range.size()) {
+            std::size_t lastPos;
+
+            if (range[pos] != '-')
+              throw std::invalid_argument(range);
+
+            last = std::stoul(range.substr(pos + 1), &lastPos);
+            if (pos + 1 + lastPos != range.size())
+              throw std::invalid_argument(range);
+          }
+        } catch (std::logic_error &) {
+          cerr << "ERROR: failed to parse core range from: " << range << endl;
+          return EXIT_FAILURE;
+        }
+
+        if (last < first) {
+          cerr << "ERROR: invalid core range: " << range << endl;
+          return EXIT_FAILURE;
+        }
+
+        // The range is only expanded once it has been checked against the
+        // target, so a silly range can't eat all our memory.
+        sessionRanges.emplace_back(first, last);
+      }
+    }
+
     if (result.count("trace")) {
       for (auto flag : result["trace"].as<std::vector<std::string>>()) {
         if (!traceFlags.parseArg(flag)) {
@@ -255,5 +426,29 @@ int main(int argc, char *argv[]) {
   target = load_target_so(soName, &traceFlags);
 #endif
 
-  return init(target, &traceFlags, from_stdin, rspPort, rspBufSize, false);
+  if (!sessionRanges.empty()) {
+    unsigned int numCores = target->getCpuCount();
+    std::vector<std::vector<unsigned int>> sessionCores;
+
+    for (auto &range : sessionRanges) {
+      if (range.second >= numCores) {
+        cerr << "ERROR: Core " << range.second << " does not exist: target has "
+             << numCores << " cores" << endl;
+        return EXIT_FAILURE;
+      }
+
+      std::vector<unsigned int> cores;
+      for (unsigned long coreNum = range.first; coreNum <= range.second;
+           coreNum++)
+        cores.push_back(static_cast<unsigned int>(coreNum));
+
+      sessionCores.push_back(cores);
+    }
+
+    return init(target, &traceFlags, sessionCores, rspPort, rspBufSize, false,
+                serverOptions);
+  }
+
+  return init(target, &traceFlags, from_stdin, rspPort, rspBufSize, false,
+              serverOptions);
 }